@@ -0,0 +1,509 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "bounds.h"
+
+// Dynamic bounding volume tree (in the style of Box2D's b2DynamicTree).
+// Leaves store a fattened copy of each object's box so small moves don't
+// touch the tree, and insertions are kept balanced with AVL-style
+// rotations. All queries write into caller-provided buffers and walk the
+// tree with a fixed-size stack, so they never allocate.
+class AABBTree
+{
+public:
+    static constexpr int nullNode = -1;
+
+private:
+    static constexpr int maxStack = 256;
+
+    struct Node
+    {
+        AABB fat;   // what the tree is built on
+        AABB tight; // the object's real box (leaves only)
+        int parent = nullNode;
+        int child1 = nullNode;
+        int child2 = nullNode;
+        int height = 0; // leaf = 0, free node = -1
+        uint32_t id = 0;
+        int next = nullNode; // free list link
+
+        bool isLeaf() const { return child1 == nullNode; }
+    };
+
+    std::vector<Node> nodes;
+    int root = nullNode;
+    int freeList = nullNode;
+    size_t leafCount = 0;
+    float margin;
+
+    static float cost(const AABB &b)
+    {
+        return (b.max.x - b.min.x) + (b.max.y - b.min.y) + (b.max.z - b.min.z);
+    }
+
+    static AABB combine(const AABB &a, const AABB &b)
+    {
+        AABB r = a;
+        r.merge(b);
+        return r;
+    }
+
+    static bool containsBox(const AABB &outer, const AABB &inner)
+    {
+        return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+               outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+    }
+
+    int allocateNode()
+    {
+        if (freeList == nullNode)
+        {
+            nodes.push_back(Node());
+            return (int)nodes.size() - 1;
+        }
+        int index = freeList;
+        freeList = nodes[index].next;
+        nodes[index] = Node();
+        return index;
+    }
+
+    void freeNode(int index)
+    {
+        nodes[index].next = freeList;
+        nodes[index].height = -1;
+        freeList = index;
+    }
+
+    void refit(int index)
+    {
+        Node &n = nodes[index];
+        n.fat = combine(nodes[n.child1].fat, nodes[n.child2].fat);
+        n.height = 1 + std::max(nodes[n.child1].height, nodes[n.child2].height);
+    }
+
+    // Rotates the subtree at iA if its children's heights differ by more
+    // than one; returns the new subtree root
+    int balance(int iA)
+    {
+        Node &A = nodes[iA];
+        if (A.isLeaf() || A.height < 2)
+        {
+            return iA;
+        }
+
+        int iB = A.child1;
+        int iC = A.child2;
+        int diff = nodes[iC].height - nodes[iB].height;
+
+        if (diff > 1)
+        {
+            return rotateUp(iA, iC, false);
+        }
+        if (diff < -1)
+        {
+            return rotateUp(iA, iB, true);
+        }
+        return iA;
+    }
+
+    // Promotes child iUp of iA; `upIsChild1` tells which slot of iA it
+    // occupied
+    int rotateUp(int iA, int iUp, bool upIsChild1)
+    {
+        Node &A = nodes[iA];
+        Node &U = nodes[iUp];
+        int iF = U.child1;
+        int iG = U.child2;
+
+        U.child1 = iA;
+        U.parent = A.parent;
+        A.parent = iUp;
+
+        if (U.parent != nullNode)
+        {
+            Node &P = nodes[U.parent];
+            if (P.child1 == iA)
+                P.child1 = iUp;
+            else
+                P.child2 = iUp;
+        }
+        else
+        {
+            root = iUp;
+        }
+
+        // Keep the taller grandchild under U, hand the other one to A
+        int keep = nodes[iF].height > nodes[iG].height ? iF : iG;
+        int give = keep == iF ? iG : iF;
+        U.child2 = keep;
+        if (upIsChild1)
+            A.child1 = give;
+        else
+            A.child2 = give;
+        nodes[give].parent = iA;
+
+        refit(iA);
+        refit(iUp);
+        return iUp;
+    }
+
+    void insertLeaf(int leaf)
+    {
+        if (root == nullNode)
+        {
+            root = leaf;
+            nodes[root].parent = nullNode;
+            return;
+        }
+
+        // Descend choosing the child whose growth costs least
+        AABB leafBox = nodes[leaf].fat;
+        int index = root;
+        while (!nodes[index].isLeaf())
+        {
+            int c1 = nodes[index].child1;
+            int c2 = nodes[index].child2;
+
+            float area = cost(nodes[index].fat);
+            float combinedArea = cost(combine(nodes[index].fat, leafBox));
+            float costHere = 2.0f * combinedArea;
+            float inheritance = 2.0f * (combinedArea - area);
+
+            float cost1 = cost(combine(leafBox, nodes[c1].fat)) + inheritance;
+            if (!nodes[c1].isLeaf())
+                cost1 -= cost(nodes[c1].fat);
+            float cost2 = cost(combine(leafBox, nodes[c2].fat)) + inheritance;
+            if (!nodes[c2].isLeaf())
+                cost2 -= cost(nodes[c2].fat);
+
+            if (costHere < cost1 && costHere < cost2)
+            {
+                break;
+            }
+            index = cost1 < cost2 ? c1 : c2;
+        }
+
+        int sibling = index;
+        int oldParent = nodes[sibling].parent;
+        int newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].fat = combine(leafBox, nodes[sibling].fat);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        if (oldParent != nullNode)
+        {
+            if (nodes[oldParent].child1 == sibling)
+                nodes[oldParent].child1 = newParent;
+            else
+                nodes[oldParent].child2 = newParent;
+        }
+        else
+        {
+            root = newParent;
+        }
+
+        fixUpwards(nodes[leaf].parent);
+    }
+
+    void removeLeaf(int leaf)
+    {
+        if (leaf == root)
+        {
+            root = nullNode;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+        if (grandParent != nullNode)
+        {
+            if (nodes[grandParent].child1 == parent)
+                nodes[grandParent].child1 = sibling;
+            else
+                nodes[grandParent].child2 = sibling;
+            nodes[sibling].parent = grandParent;
+            freeNode(parent);
+            fixUpwards(grandParent);
+        }
+        else
+        {
+            root = sibling;
+            nodes[sibling].parent = nullNode;
+            freeNode(parent);
+        }
+    }
+
+    void fixUpwards(int index)
+    {
+        while (index != nullNode)
+        {
+            index = balance(index);
+            refit(index);
+            index = nodes[index].parent;
+        }
+    }
+
+    static float distanceSquared(const AABB &b, const Vector3 &p)
+    {
+        float dx = std::max(std::max(b.min.x - p.x, 0.0f), p.x - b.max.x);
+        float dy = std::max(std::max(b.min.y - p.y, 0.0f), p.y - b.max.y);
+        float dz = std::max(std::max(b.min.z - p.z, 0.0f), p.z - b.max.z);
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Slab test; returns the entry distance or -1 when the ray misses
+    static float rayEntry(const AABB &b, const Vector3 &origin, const Vector3 &dir, float maxT)
+    {
+        float tMin = 0.0f;
+        float tMax = maxT;
+        const float o[3] = {origin.x, origin.y, origin.z};
+        const float d[3] = {dir.x, dir.y, dir.z};
+        const float lo[3] = {b.min.x, b.min.y, b.min.z};
+        const float hi[3] = {b.max.x, b.max.y, b.max.z};
+        for (int i = 0; i < 3; i++)
+        {
+            if (d[i] == 0.0f)
+            {
+                if (o[i] < lo[i] || o[i] > hi[i])
+                    return -1.0f;
+                continue;
+            }
+            float inv = 1.0f / d[i];
+            float t1 = (lo[i] - o[i]) * inv;
+            float t2 = (hi[i] - o[i]) * inv;
+            if (t1 > t2)
+                std::swap(t1, t2);
+            tMin = std::max(tMin, t1);
+            tMax = std::min(tMax, t2);
+            if (tMin > tMax)
+                return -1.0f;
+        }
+        return tMin;
+    }
+
+public:
+    explicit AABBTree(float margin = 0.5f) : margin(margin) {}
+
+    int insert(uint32_t id, const AABB &box)
+    {
+        int leaf = allocateNode();
+        Node &n = nodes[leaf];
+        n.id = id;
+        n.tight = box;
+        n.fat = AABB(box.min - Vector3(margin, margin, margin), box.max + Vector3(margin, margin, margin));
+        n.height = 0;
+        leafCount++;
+        insertLeaf(leaf);
+        return leaf;
+    }
+
+    void remove(int leaf)
+    {
+        removeLeaf(leaf);
+        freeNode(leaf);
+        leafCount--;
+    }
+
+    // Updates the object's box. The tree is only restructured when the box
+    // leaves its fattened copy; the new fat box is stretched in the
+    // direction of travel to absorb the next few moves.
+    bool move(int leaf, const AABB &box)
+    {
+        Vector3 displacement = box.center() - nodes[leaf].tight.center();
+        nodes[leaf].tight = box;
+        if (containsBox(nodes[leaf].fat, box))
+        {
+            return false;
+        }
+
+        removeLeaf(leaf);
+        AABB fat(box.min - Vector3(margin, margin, margin), box.max + Vector3(margin, margin, margin));
+        Vector3 d = displacement * 2.0f;
+        if (d.x < 0) fat.min.x += d.x; else fat.max.x += d.x;
+        if (d.y < 0) fat.min.y += d.y; else fat.max.y += d.y;
+        if (d.z < 0) fat.min.z += d.z; else fat.max.z += d.z;
+        nodes[leaf].fat = fat;
+        insertLeaf(leaf);
+        return true;
+    }
+
+    uint32_t getId(int leaf) const { return nodes[leaf].id; }
+    const AABB &getFatBounds(int leaf) const { return nodes[leaf].fat; }
+    size_t size() const { return leafCount; }
+    int getHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+
+    // Calls visit(id) for every object whose box overlaps `box`; the
+    // visitor returns false to stop early
+    template <typename Visitor>
+    void queryRect(const AABB &box, Visitor &&visit) const
+    {
+        if (root == nullNode)
+        {
+            return;
+        }
+        int stack[maxStack];
+        int top = 0;
+        stack[top++] = root;
+        while (top > 0)
+        {
+            const Node &n = nodes[stack[--top]];
+            if (!n.fat.overlaps(box))
+            {
+                continue;
+            }
+            if (n.isLeaf())
+            {
+                if (n.tight.overlaps(box) && !visit(n.id))
+                {
+                    return;
+                }
+            }
+            else if (top + 2 <= maxStack)
+            {
+                stack[top++] = n.child1;
+                stack[top++] = n.child2;
+            }
+        }
+    }
+
+    // Calls visit(id, t) for every object hit by origin + t * dir with
+    // t in [0, maxT], t being the entry distance. Unordered.
+    template <typename Visitor>
+    void raycast(const Vector3 &origin, const Vector3 &dir, float maxT, Visitor &&visit) const
+    {
+        if (root == nullNode)
+        {
+            return;
+        }
+        int stack[maxStack];
+        int top = 0;
+        stack[top++] = root;
+        while (top > 0)
+        {
+            const Node &n = nodes[stack[--top]];
+            if (rayEntry(n.fat, origin, dir, maxT) < 0.0f)
+            {
+                continue;
+            }
+            if (n.isLeaf())
+            {
+                float t = rayEntry(n.tight, origin, dir, maxT);
+                if (t >= 0.0f && !visit(n.id, t))
+                {
+                    return;
+                }
+            }
+            else if (top + 2 <= maxStack)
+            {
+                stack[top++] = n.child1;
+                stack[top++] = n.child2;
+            }
+        }
+    }
+
+    // Buffer forms of the queries above; return how many ids were written
+    size_t queryRect(const AABB &box, uint32_t *out, size_t capacity) const
+    {
+        size_t count = 0;
+        if (capacity > 0)
+        {
+            queryRect(box, [&](uint32_t id)
+                      {
+                          out[count++] = id;
+                          return count < capacity; });
+        }
+        return count;
+    }
+
+    size_t queryPoint(const Vector3 &p, uint32_t *out, size_t capacity) const
+    {
+        return queryRect(AABB(p, p), out, capacity);
+    }
+
+    size_t raycast(const Vector3 &origin, const Vector3 &dir, float maxT,
+                   uint32_t *out, float *distances, size_t capacity) const
+    {
+        size_t count = 0;
+        if (capacity > 0)
+        {
+            raycast(origin, dir, maxT, [&](uint32_t id, float t)
+                    {
+                        if (distances)
+                            distances[count] = t;
+                        out[count++] = id;
+                        return count < capacity; });
+        }
+        return count;
+    }
+
+    // The k objects whose boxes are closest to p, nearest first. `out` and
+    // `distancesSq` must hold k entries; `map` turns an id into whatever
+    // `out` stores. Returns how many were found.
+    template <typename T, typename Map>
+    size_t nearest(const Vector3 &p, size_t k, T *out, float *distancesSq, Map &&map) const
+    {
+        if (root == nullNode || k == 0)
+        {
+            return 0;
+        }
+        size_t count = 0;
+        int stack[maxStack];
+        int top = 0;
+        stack[top++] = root;
+        while (top > 0)
+        {
+            int index = stack[--top];
+            const Node &n = nodes[index];
+            float worst = count == k ? distancesSq[k - 1] : std::numeric_limits<float>::infinity();
+            if (distanceSquared(n.fat, p) > worst)
+            {
+                continue; // nothing in here can beat the current k-th best
+            }
+            if (n.isLeaf())
+            {
+                float d = distanceSquared(n.tight, p);
+                if (d >= worst)
+                {
+                    continue;
+                }
+                // Insertion into the sorted result list
+                size_t i = count < k ? count++ : k - 1;
+                while (i > 0 && distancesSq[i - 1] > d)
+                {
+                    distancesSq[i] = distancesSq[i - 1];
+                    out[i] = out[i - 1];
+                    i--;
+                }
+                distancesSq[i] = d;
+                out[i] = map(n.id);
+            }
+            else if (top + 2 <= maxStack)
+            {
+                // Push the farther child first so the nearer one is visited next
+                float d1 = distanceSquared(nodes[n.child1].fat, p);
+                float d2 = distanceSquared(nodes[n.child2].fat, p);
+                stack[top++] = d1 < d2 ? n.child2 : n.child1;
+                stack[top++] = d1 < d2 ? n.child1 : n.child2;
+            }
+        }
+        return count;
+    }
+
+    size_t nearest(const Vector3 &p, size_t k, uint32_t *out, float *distancesSq) const
+    {
+        return nearest(p, k, out, distancesSq, [](uint32_t id)
+                       { return id; });
+    }
+};
+
+#endif
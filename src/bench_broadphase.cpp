@@ -0,0 +1,112 @@
+// Broad phase benchmark: SpatialHash::findPairs() against checking every
+// pair of boxes, on boxes that move a little every frame (like World's
+// shapes). Needs no GL context:
+//
+//     clang++ -std=c++17 -O2 src/bench_broadphase.cpp -o bench_broadphase
+//     ./bench_broadphase [boxes] [frames]
+//
+// Prints the overlapping pairs found per second by each and checks that
+// both report the same pairs.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+#include "spatial_hash.h"
+
+typedef std::vector<std::pair<uint32_t, uint32_t>> PairList;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void bruteForcePairs(const std::vector<AABB> &boxes, PairList &out)
+{
+    for (uint32_t i = 0; i < boxes.size(); i++)
+    {
+        for (uint32_t j = i + 1; j < boxes.size(); j++)
+        {
+            if (boxes[i].overlaps(boxes[j]))
+            {
+                out.push_back(std::make_pair(i, j));
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    int frames = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    // Boxes of side 0.5..2 scattered over a square sized for a few
+    // overlaps per box, as in a busy scene
+    float side = std::sqrt((float)count) * 2.0f;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(0.0f, side);
+    std::uniform_real_distribution<float> extent(0.25f, 1.0f);
+    std::uniform_real_distribution<float> step(-0.1f, 0.1f);
+    std::vector<Vector3> centers(count);
+    std::vector<Vector3> halfSizes(count);
+    std::vector<AABB> boxes(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        centers[i] = Vector3(position(rng), position(rng), 0.0f);
+        halfSizes[i] = Vector3(extent(rng), extent(rng), 0.0f);
+    }
+    auto place = [&](size_t i)
+    { boxes[i] = AABB(centers[i] - halfSizes[i], centers[i] + halfSizes[i]); };
+
+    SpatialHash hash;
+    hash.setCellSize(4.0f); // about twice the largest box
+    for (size_t i = 0; i < count; i++)
+    {
+        place(i);
+        hash.insert((uint32_t)i, boxes[i]);
+    }
+
+    PairList hashPairs, brutePairs;
+    double hashMs = 0.0, bruteMs = 0.0;
+    size_t hashFound = 0, bruteFound = 0;
+    bool same = true;
+    for (int f = 0; f < frames; f++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            centers[i] += Vector3(step(rng), step(rng), 0.0f);
+            place(i);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++)
+        {
+            hash.update((uint32_t)i, boxes[i]);
+        }
+        hashPairs.clear();
+        hash.findPairs(hashPairs);
+        hashMs += millisecondsSince(start);
+        hashFound += hashPairs.size();
+
+        start = std::chrono::steady_clock::now();
+        brutePairs.clear();
+        bruteForcePairs(boxes, brutePairs);
+        bruteMs += millisecondsSince(start);
+        bruteFound += brutePairs.size();
+
+        std::sort(hashPairs.begin(), hashPairs.end());
+        same = same && hashPairs == brutePairs; // brute force emits them sorted
+    }
+
+    std::printf("%zu boxes, %d frames, %.1f pairs per frame\n", count, frames, (double)hashFound / frames);
+    std::printf("spatial hash (update + findPairs): %8.2f ms/frame, %12.0f pairs/s\n",
+                hashMs / frames, hashFound / (hashMs / 1000.0));
+    std::printf("brute force:                       %8.2f ms/frame, %12.0f pairs/s\n",
+                bruteMs / frames, bruteFound / (bruteMs / 1000.0));
+    std::printf("speedup %.1fx, pair sets %s\n", bruteMs / hashMs, same ? "identical" : "DIFFER");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Math benchmark behind the constexpr / no-identity-fill Mat4, the fused
+// `v + p * s` (ScaledVector) and the decision not to make Mat4 chains
+// lazy. Needs no GL context; build
+// it both ways, since the compile script builds without optimization:
+//
+//     clang++ -std=c++17 -O0 src/bench_math.cpp -o bench_math && ./bench_math
+//     clang++ -std=c++17 -O2 src/bench_math.cpp -o bench_math && ./bench_math
+//
+// Compares, in ns per operation:
+// - A * B * C and ortho() on Mat4 against LegacyMat4, a copy of the
+//   previous constructors (memset identity in every constructor,
+//   ortho() filling the identity a second time) over the same kernels
+// - a lazy expression-template matrix chain against plain products
+// - the fused `v + p * s` against evaluating `p * s` into a temporary
+//   first, as the operators did before ScaledVector
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "vector.h"
+
+static float sink = 0.0f; // results are added here so loops aren't removed
+
+template <typename Body>
+static double nanosecondsPerOp(size_t count, Body &&body)
+{
+    const int reps = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            body(i);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (reps * (double)count);
+}
+
+// The Mat4 constructors as they were before constexpr
+struct LegacyMat4
+{
+    float m[16];
+
+    LegacyMat4()
+    {
+        loadIdentity();
+    }
+
+    void loadIdentity()
+    {
+        memset(m, 0, sizeof(m));
+        m[0] = m[5] = m[10] = m[15] = 1.0f;
+    }
+
+    static LegacyMat4 ortho(float left, float right, float bottom, float top, float zNear, float zFar)
+    {
+        LegacyMat4 r;
+        r.loadIdentity();
+        r.m[0] = 2.0f / (right - left);
+        r.m[5] = 2.0f / (top - bottom);
+        r.m[10] = -2.0f / (zFar - zNear);
+        r.m[12] = -(right + left) / (right - left);
+        r.m[13] = -(top + bottom) / (top - bottom);
+        r.m[14] = -(zFar + zNear) / (zFar - zNear);
+        return r;
+    }
+
+    LegacyMat4 operator*(const LegacyMat4 &o) const
+    {
+        LegacyMat4 r;
+        mat4Kernels().multiply(m, o.m, r.m);
+        return r;
+    }
+};
+
+// Expression-template prototype: A * B * C builds a lazy node and is
+// evaluated one output column at a time as A * (B * (C * e_j)), so no
+// intermediate matrix is stored
+template <typename L, typename R>
+struct MatProduct
+{
+    const L &l;
+    const R &r;
+
+    Vector4 column(int j) const
+    {
+        return l.column(r.column(j));
+    }
+    Vector4 column(const Vector4 &v) const
+    {
+        return l.column(r.column(v));
+    }
+};
+
+struct MatRef
+{
+    const Mat4 &a;
+
+    Vector4 column(int j) const
+    {
+        return Vector4(a.m[j * 4], a.m[j * 4 + 1], a.m[j * 4 + 2], a.m[j * 4 + 3]);
+    }
+    Vector4 column(const Vector4 &v) const
+    {
+        return a * v;
+    }
+};
+
+template <typename L, typename R>
+MatProduct<L, R> lazyProduct(const L &l, const R &r)
+{
+    return MatProduct<L, R>{l, r};
+}
+
+template <typename E>
+Mat4 evaluate(const E &e)
+{
+    Mat4 out;
+    for (int j = 0; j < 4; j++)
+    {
+        Vector4 c = e.column(j);
+        out.m[j * 4] = c.x;
+        out.m[j * 4 + 1] = c.y;
+        out.m[j * 4 + 2] = c.z;
+        out.m[j * 4 + 3] = c.w;
+    }
+    return out;
+}
+
+int main()
+{
+    const size_t count = 4096;
+    std::vector<Mat4> mats(count + 2);
+    std::vector<LegacyMat4> legacy(count + 2);
+    std::vector<Vector3> points(count + 1);
+    for (size_t i = 0; i < mats.size(); i++)
+    {
+        mats[i] = Mat4::compose(Vector3(i * 0.1f, -(float)i, 0.5f), i * 0.01f, Vector3(1.0f + i % 3, 2.0f, 1.0f));
+        memcpy(legacy[i].m, mats[i].m, sizeof(mats[i].m));
+    }
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        points[i] = Vector3(i * 0.5f, i * 0.25f, 1.0f);
+    }
+
+    std::printf("kernels: %s\n", simdLevelName(mat4Kernels().level));
+
+    double chainNow = nanosecondsPerOp(count, [&](size_t i)
+                                       { sink += (mats[i] * mats[i + 1] * mats[i + 2]).m[13]; });
+    double chainLegacy = nanosecondsPerOp(count, [&](size_t i)
+                                          { sink += (legacy[i] * legacy[i + 1] * legacy[i + 2]).m[13]; });
+    std::printf("A * B * C      legacy %7.2f ns   current %7.2f ns\n", chainLegacy, chainNow);
+
+    double orthoNow = nanosecondsPerOp(count, [&](size_t i)
+                                       { sink += Mat4::ortho(0.0f, 50.0f + i, 0.0f, 50.0f, -1.0f, 1.0f).m[0]; });
+    double orthoLegacy = nanosecondsPerOp(count, [&](size_t i)
+                                          { sink += LegacyMat4::ortho(0.0f, 50.0f + i, 0.0f, 50.0f, -1.0f, 1.0f).m[0]; });
+    std::printf("ortho()        legacy %7.2f ns   current %7.2f ns\n", orthoLegacy, orthoNow);
+
+    double chainLazy = nanosecondsPerOp(count, [&](size_t i)
+                                        {
+        MatRef a{mats[i]}, b{mats[i + 1]}, c{mats[i + 2]};
+        sink += evaluate(lazyProduct(a, lazyProduct(b, c))).m[13]; });
+    std::printf("A * B * C      plain  %7.2f ns   expression template %7.2f ns\n", chainNow, chainLazy);
+
+    float s = 0.5f;
+    Vector3 acc;
+    double fusedPlain = nanosecondsPerOp(count, [&](size_t i)
+                                         { acc = points[i] + points[i + 1].scaled(s); sink += acc.y; });
+    double fusedLazy = nanosecondsPerOp(count, [&](size_t i)
+                                        { acc = points[i] + points[i + 1] * s; sink += acc.y; });
+    std::printf("v + p * s      plain  %7.2f ns   fused (ScaledVector) %7.2f ns\n", fusedPlain, fusedLazy);
+
+    return sink == 12345.0f; // never true; keeps `sink` observable
+}
@@ -0,0 +1,249 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include "vector.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define BOUNDS_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BOUNDS_NEON 1
+#endif
+
+// Axis-aligned bounding box. A default constructed box is empty
+// (min = +inf, max = -inf) so expanding it by any point gives that point.
+struct AABB
+{
+    Vector3 min;
+    Vector3 max;
+
+    AABB()
+        : min(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()),
+          max(-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity())
+    {
+    }
+    AABB(const Vector3 &min, const Vector3 &max) : min(min), max(max) {}
+
+    bool isEmpty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    void expand(const Vector3 &p)
+    {
+        min = Vector3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+        max = Vector3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+    }
+
+    void merge(const AABB &o)
+    {
+        min = Vector3(std::min(min.x, o.min.x), std::min(min.y, o.min.y), std::min(min.z, o.min.z));
+        max = Vector3(std::max(max.x, o.max.x), std::max(max.y, o.max.y), std::max(max.z, o.max.z));
+    }
+
+    // True when p lies on one of the faces, i.e. removing it may shrink the box
+    bool touches(const Vector3 &p) const
+    {
+        return p.x == min.x || p.y == min.y || p.z == min.z ||
+               p.x == max.x || p.y == max.y || p.z == max.z;
+    }
+
+    bool overlaps(const AABB &o) const
+    {
+        return min.x <= o.max.x && max.x >= o.min.x &&
+               min.y <= o.max.y && max.y >= o.min.y &&
+               min.z <= o.max.z && max.z >= o.min.z;
+    }
+
+    bool contains(const Vector3 &p) const
+    {
+        return p.x >= min.x && p.x <= max.x &&
+               p.y >= min.y && p.y <= max.y &&
+               p.z >= min.z && p.z <= max.z;
+    }
+
+    Vector3 center() const { return (min + max) * 0.5f; }
+    Vector3 extents() const { return (max - min) * 0.5f; }
+
+    AABB translated(const Vector3 &d) const
+    {
+        return AABB(min + d, max + d);
+    }
+
+    // Bounds of this box after an affine transform (Arvo's method)
+    AABB transformed(const Mat4 &m) const
+    {
+        if (isEmpty())
+        {
+            return *this;
+        }
+        float lo[3] = {min.x, min.y, min.z};
+        float hi[3] = {max.x, max.y, max.z};
+        float outLo[3] = {m.m[12], m.m[13], m.m[14]};
+        float outHi[3] = {m.m[12], m.m[13], m.m[14]};
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                float a = m.m[col * 4 + row] * lo[col];
+                float b = m.m[col * 4 + row] * hi[col];
+                outLo[row] += std::min(a, b);
+                outHi[row] += std::max(a, b);
+            }
+        }
+        return AABB(Vector3(outLo[0], outLo[1], outLo[2]), Vector3(outHi[0], outHi[1], outHi[2]));
+    }
+
+    // Min/max reduction over a vertex array. Each Vector3 is loaded as one
+    // 4-wide register (the fourth lane is the next vertex's x and ignored),
+    // so every element but the last can use an unaligned vector load.
+    static AABB fromPoints(const Vector3 *points, size_t count)
+    {
+        AABB box;
+        if (count == 0)
+        {
+            return box;
+        }
+#if defined(BOUNDS_SSE)
+        __m128 lo = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        __m128 hi = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        for (size_t i = 0; i + 1 < count; i++)
+        {
+            __m128 p = _mm_loadu_ps(&points[i].x);
+            lo = _mm_min_ps(lo, p);
+            hi = _mm_max_ps(hi, p);
+        }
+        float l[4], h[4];
+        _mm_storeu_ps(l, lo);
+        _mm_storeu_ps(h, hi);
+        box = AABB(Vector3(l[0], l[1], l[2]), Vector3(h[0], h[1], h[2]));
+#elif defined(BOUNDS_NEON)
+        float32x4_t lo = vdupq_n_f32(std::numeric_limits<float>::infinity());
+        float32x4_t hi = vdupq_n_f32(-std::numeric_limits<float>::infinity());
+        for (size_t i = 0; i + 1 < count; i++)
+        {
+            float32x4_t p = vld1q_f32(&points[i].x);
+            lo = vminq_f32(lo, p);
+            hi = vmaxq_f32(hi, p);
+        }
+        float l[4], h[4];
+        vst1q_f32(l, lo);
+        vst1q_f32(h, hi);
+        box = AABB(Vector3(l[0], l[1], l[2]), Vector3(h[0], h[1], h[2]));
+#else
+        for (size_t i = 0; i + 1 < count; i++)
+        {
+            box.expand(points[i]);
+        }
+#endif
+        box.expand(points[count - 1]); // last one would read past the end
+        return box;
+    }
+
+    // Same over padded vectors: every element is one aligned load
+    static AABB fromPoints(const Vector3A *points, size_t count)
+    {
+        AABB box;
+#if defined(BOUNDS_SSE)
+        __m128 lo = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        __m128 hi = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        for (size_t i = 0; i < count; i++)
+        {
+            __m128 p = _mm_load_ps(&points[i].x);
+            lo = _mm_min_ps(lo, p);
+            hi = _mm_max_ps(hi, p);
+        }
+        Vector3A l, h;
+        _mm_store_ps(&l.x, lo);
+        _mm_store_ps(&h.x, hi);
+        box = AABB(l, h);
+#elif defined(BOUNDS_NEON)
+        float32x4_t lo = vdupq_n_f32(std::numeric_limits<float>::infinity());
+        float32x4_t hi = vdupq_n_f32(-std::numeric_limits<float>::infinity());
+        for (size_t i = 0; i < count; i++)
+        {
+            float32x4_t p = vld1q_f32(&points[i].x);
+            lo = vminq_f32(lo, p);
+            hi = vmaxq_f32(hi, p);
+        }
+        Vector3A l, h;
+        vst1q_f32(&l.x, lo);
+        vst1q_f32(&h.x, hi);
+        box = AABB(l, h);
+#else
+        for (size_t i = 0; i < count; i++)
+        {
+            box.expand(points[i]);
+        }
+#endif
+        return box;
+    }
+};
+
+// Writes the indices of the rectangles (given as separate min/max lanes)
+// that overlap `view` on x and y into `out`, which must hold `count`
+// entries. Returns how many were visible. Tests four boxes per step.
+inline size_t cullRects(const float *minX, const float *minY, const float *maxX, const float *maxY,
+                        size_t count, const AABB &view, uint32_t *out)
+{
+    size_t visible = 0;
+    size_t i = 0;
+#if defined(BOUNDS_SSE)
+    __m128 viewMinX = _mm_set1_ps(view.min.x);
+    __m128 viewMinY = _mm_set1_ps(view.min.y);
+    __m128 viewMaxX = _mm_set1_ps(view.max.x);
+    __m128 viewMaxY = _mm_set1_ps(view.max.y);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minX + i), viewMaxX),
+                                              _mm_cmpge_ps(_mm_loadu_ps(maxX + i), viewMinX)),
+                                   _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minY + i), viewMaxY),
+                                              _mm_cmpge_ps(_mm_loadu_ps(maxY + i), viewMinY)));
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; mask != 0 && lane < 4; lane++)
+        {
+            if (mask & (1 << lane))
+            {
+                out[visible++] = (uint32_t)(i + lane);
+            }
+        }
+    }
+#elif defined(BOUNDS_NEON)
+    float32x4_t viewMinX = vdupq_n_f32(view.min.x);
+    float32x4_t viewMinY = vdupq_n_f32(view.min.y);
+    float32x4_t viewMaxX = vdupq_n_f32(view.max.x);
+    float32x4_t viewMaxY = vdupq_n_f32(view.max.y);
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32x4_t inside = vandq_u32(vandq_u32(vcleq_f32(vld1q_f32(minX + i), viewMaxX),
+                                                vcgeq_f32(vld1q_f32(maxX + i), viewMinX)),
+                                      vandq_u32(vcleq_f32(vld1q_f32(minY + i), viewMaxY),
+                                                vcgeq_f32(vld1q_f32(maxY + i), viewMinY)));
+        uint32_t lanes[4];
+        vst1q_u32(lanes, inside);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (lanes[lane])
+            {
+                out[visible++] = (uint32_t)(i + lane);
+            }
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        if (minX[i] <= view.max.x && maxX[i] >= view.min.x &&
+            minY[i] <= view.max.y && maxY[i] >= view.min.y)
+        {
+            out[visible++] = (uint32_t)i;
+        }
+    }
+    return visible;
+}
+
+#endif
@@ -0,0 +1,502 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include "vector.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "shader.h"
+#include "slot_map.h"
+
+// Vertex layouts a shape can upload. The 2D ones drop z (always 0) for
+// flat shapes when the World is in 2D mode.
+enum class VertexFormat
+{
+    Position,        // bare Vector3
+    PositionColor,   // ColorVertex
+    Position2D,      // bare Vector2
+    Position2DColor  // ColorVertex2D
+};
+
+constexpr size_t vertexFormatCount = 4;
+
+// Interleaved layout used once a shape carries per-vertex colors
+struct ColorVertex
+{
+    Vector3 position;
+    uint8_t color[4]; // RGBA8, normalized by the attribute
+};
+
+struct ColorVertex2D
+{
+    Vector2 position;
+    uint8_t color[4];
+};
+
+static_assert(sizeof(ColorVertex) == 16 && sizeof(ColorVertex2D) == 12, "vertex layouts must be packed");
+
+inline bool hasColorAttribute(VertexFormat format)
+{
+    return format == VertexFormat::PositionColor || format == VertexFormat::Position2DColor;
+}
+
+inline bool isFlatFormat(VertexFormat format)
+{
+    return format == VertexFormat::Position2D || format == VertexFormat::Position2DColor;
+}
+
+inline size_t vertexStride(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::PositionColor:
+        return sizeof(ColorVertex);
+    case VertexFormat::Position2D:
+        return sizeof(Vector2);
+    case VertexFormat::Position2DColor:
+        return sizeof(ColorVertex2D);
+    default:
+        return sizeof(Vector3);
+    }
+}
+
+// Points the bound VAO at the bound GL_ARRAY_BUFFER, vertex 0 at byte 0.
+// 2D formats feed two components; a vec3 aPos then reads z as 0.
+inline void specifyVertexFormat(VertexFormat format)
+{
+    GLsizei stride = (GLsizei)vertexStride(format);
+    glVertexAttribPointer(ShaderProgram::positionAttribute /*the shader location*/,
+                          isFlatFormat(format) ? 2 : 3 /*Vertex size*/,
+                          GL_FLOAT /*data type*/,
+                          GL_FALSE /*Tell glad not to normalize the vectors*/,
+                          stride /*Distance between bytes */,
+                          (void *)0 /*Byte offset */); // GPU configuration for vertex drawing
+    GLState &state = GLState::getInstance();
+    state.enableVertexAttribArray(ShaderProgram::positionAttribute);
+
+    if (hasColorAttribute(format))
+    {
+        size_t offset = isFlatFormat(format) ? offsetof(ColorVertex2D, color) : offsetof(ColorVertex, color);
+        glVertexAttribPointer(ShaderProgram::colorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE /*0..255 -> 0..1*/,
+                              stride, (void *)offset);
+        state.enableVertexAttribArray(ShaderProgram::colorAttribute);
+    }
+    else
+    {
+        state.disableVertexAttribArray(ShaderProgram::colorAttribute); // reads the white default
+    }
+}
+
+// Best-fit range allocator over [0, capacity) in abstract units. Free
+// ranges are indexed by offset (to coalesce neighbours on free) and by
+// size (to find the smallest range that fits), so both are O(log n).
+class OffsetAllocator
+{
+private:
+    std::map<uint32_t, uint32_t> freeByOffset;    // offset -> size
+    std::multimap<uint32_t, uint32_t> freeBySize; // size -> offset
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+
+    void eraseFree(std::map<uint32_t, uint32_t>::iterator it)
+    {
+        auto range = freeBySize.equal_range(it->second);
+        for (auto s = range.first; s != range.second; ++s)
+        {
+            if (s->second == it->first)
+            {
+                freeBySize.erase(s);
+                break;
+            }
+        }
+        freeByOffset.erase(it);
+    }
+
+    // Returns [offset, offset + size) to the free lists, merging neighbours
+    void insertFree(uint32_t offset, uint32_t size)
+    {
+        auto next = freeByOffset.lower_bound(offset);
+        if (next != freeByOffset.end() && next->first == offset + size)
+        {
+            size += next->second;
+            auto after = std::next(next);
+            eraseFree(next);
+            next = after;
+        }
+        if (next != freeByOffset.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                offset = prev->first;
+                size += prev->second;
+                eraseFree(prev);
+            }
+        }
+        freeByOffset[offset] = size;
+        freeBySize.insert(std::make_pair(size, offset));
+    }
+
+    // Takes `size` units from the front of the free range at `it`
+    uint32_t carve(std::map<uint32_t, uint32_t>::iterator it, uint32_t size)
+    {
+        uint32_t offset = it->first;
+        uint32_t rest = it->second - size;
+        eraseFree(it);
+        if (rest > 0)
+        {
+            freeByOffset[offset + size] = rest;
+            freeBySize.insert(std::make_pair(rest, offset + size));
+        }
+        used += size;
+        return offset;
+    }
+
+public:
+    static constexpr uint32_t npos = 0xFFFFFFFFu;
+
+    // Offset of a new range of `size` units, npos when no free range fits
+    uint32_t allocate(uint32_t size)
+    {
+        auto fit = freeBySize.lower_bound(size);
+        if (fit == freeBySize.end())
+        {
+            return npos;
+        }
+        return carve(freeByOffset.find(fit->second), size);
+    }
+
+    // Lowest free range that fits entirely below `limit`; used to slide
+    // allocations towards the front of the buffer
+    uint32_t allocateBelow(uint32_t size, uint32_t limit)
+    {
+        for (auto it = freeByOffset.begin(); it != freeByOffset.end() && it->first + size <= limit; ++it)
+        {
+            if (it->second >= size)
+            {
+                return carve(it, size);
+            }
+        }
+        return npos;
+    }
+
+    void free(uint32_t offset, uint32_t size)
+    {
+        used -= size;
+        insertFree(offset, size);
+    }
+
+    // Appends free space at the end
+    void grow(uint32_t newCapacity)
+    {
+        if (newCapacity > capacity)
+        {
+            insertFree(capacity, newCapacity - capacity);
+            capacity = newCapacity;
+        }
+    }
+
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getUsed() const { return used; }
+    uint32_t getFree() const { return capacity - used; }
+    uint32_t getLargestFree() const { return freeBySize.empty() ? 0 : freeBySize.rbegin()->first; }
+    size_t getFreeRangeCount() const { return freeByOffset.size(); }
+};
+
+typedef SlotHandle GeometryHandle;
+
+struct GeometryPoolStats
+{
+    size_t bufferBytes;      // GL storage held by the pool
+    size_t usedBytes;        // handed out to shapes
+    size_t freeBytes;        // bufferBytes - usedBytes
+    size_t largestFreeBytes; // biggest single free range
+    float fragmentation;     // 1 - largest free / free, per buffer; 0 when each buffer's free space is one range
+    size_t allocations;
+    size_t bytesMoved; // copied by compact() so far
+};
+
+// Shared vertex and index storage for every pooled shape. Each vertex
+// format gets one large vertex buffer, one index buffer and a single VAO
+// describing them, so consecutive draws of the same format need no VAO or
+// buffer rebinds: a shape just draws its range with a base vertex.
+// Ranges are handed out by an OffsetAllocator and referenced through
+// generational handles, which lets compact() slide them towards the start
+// of the buffer between frames without the owners noticing.
+class GeometryPool
+{
+public:
+    enum class Space
+    {
+        Vertices, // units are whole vertices of the format
+        Indices   // units are 4 bytes, so 16- and 32-bit indices stay aligned
+    };
+
+private:
+    static constexpr size_t formatCount = vertexFormatCount;
+    static constexpr uint32_t initialVertices = 16384;
+    static constexpr uint32_t initialIndexUnits = 16384;
+    static constexpr size_t indexUnit = 4;
+
+    // One GL buffer and the allocator carving it up
+    struct Region
+    {
+        GpuBuffer buffer;
+        OffsetAllocator space;
+        size_t unit = 1;                           // bytes per allocator unit
+        std::map<uint32_t, GeometryHandle> owners; // live ranges by offset, for compaction
+    };
+
+    struct Arena
+    {
+        Region vertices;
+        Region indices;
+        VertexArray vertexArray;
+        bool layoutDirty = true; // buffers were replaced since the VAO was specified
+    };
+
+    struct Block
+    {
+        VertexFormat format;
+        Space space;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    Arena arenas[formatCount];
+    SlotMap<Block> blocks;
+    size_t bytesMoved = 0;
+
+    GeometryPool()
+    {
+        GpuResources::getInstance(); // constructed first so it outlives our buffers at exit
+        for (size_t f = 0; f < formatCount; f++)
+        {
+            arenas[f].vertices.buffer = GpuBuffer(GL_ARRAY_BUFFER);
+            arenas[f].vertices.unit = vertexStride((VertexFormat)f);
+            // Written through the copy target so uploads never touch the
+            // element binding of whatever VAO is bound
+            arenas[f].indices.buffer = GpuBuffer(GL_COPY_WRITE_BUFFER);
+            arenas[f].indices.unit = indexUnit;
+        }
+    }
+
+    Region &region(VertexFormat format, Space space)
+    {
+        Arena &arena = arenas[(size_t)format];
+        return space == Space::Vertices ? arena.vertices : arena.indices;
+    }
+
+    // Moves the region into a bigger buffer, copying the contents on the GPU
+    void grow(Arena &arena, Region &r, uint32_t minUnits)
+    {
+        uint32_t capacity = r.space.getCapacity();
+        uint32_t initial = &r == &arena.vertices ? initialVertices : initialIndexUnits;
+        uint32_t newCapacity = std::max(std::max(capacity * 2, capacity + minUnits), initial);
+
+        GpuBuffer grown(r.buffer.getTarget());
+        grown.setData(newCapacity * r.unit, nullptr, GL_DYNAMIC_DRAW);
+        if (capacity > 0)
+        {
+            GLState::getInstance().bindBuffer(GL_COPY_READ_BUFFER, r.buffer.id());
+            GLState::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, grown.id());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * r.unit);
+        }
+        r.buffer = std::move(grown);
+        r.space.grow(newCapacity);
+        arena.layoutDirty = true;
+    }
+
+public:
+    GeometryPool(const GeometryPool &) = delete;
+    GeometryPool &operator=(const GeometryPool &) = delete;
+
+    static GeometryPool &getInstance()
+    {
+        static GeometryPool instance;
+        return instance;
+    }
+
+    // Reserves `units` vertices or index units, growing the buffer if needed
+    GeometryHandle allocate(VertexFormat format, Space space, size_t units)
+    {
+        Arena &arena = arenas[(size_t)format];
+        Region &r = region(format, space);
+        uint32_t size = (uint32_t)std::max<size_t>(units, 1);
+        uint32_t offset = r.space.allocate(size);
+        if (offset == OffsetAllocator::npos)
+        {
+            grow(arena, r, size);
+            offset = r.space.allocate(size);
+        }
+        GeometryHandle handle = blocks.insert({format, space, offset, size});
+        r.owners[offset] = handle;
+        return handle;
+    }
+
+    void free(GeometryHandle handle)
+    {
+        const Block *block = blocks.get(handle);
+        if (block == nullptr)
+        {
+            return;
+        }
+        Region &r = region(block->format, block->space);
+        r.space.free(block->offset, block->size);
+        r.owners.erase(block->offset);
+        blocks.erase(handle);
+    }
+
+    bool contains(GeometryHandle handle) const
+    {
+        return blocks.contains(handle);
+    }
+
+    VertexFormat formatOf(GeometryHandle handle) const
+    {
+        return blocks.get(handle)->format;
+    }
+
+    // Allocation size in units
+    size_t capacityOf(GeometryHandle handle) const
+    {
+        const Block *block = blocks.get(handle);
+        return block != nullptr ? block->size : 0;
+    }
+
+    // Start of the range in units: the base vertex for vertex ranges
+    uint32_t offsetOf(GeometryHandle handle) const
+    {
+        return blocks.get(handle)->offset;
+    }
+
+    size_t byteOffsetOf(GeometryHandle handle) const
+    {
+        const Block *block = blocks.get(handle);
+        return block->offset * (block->space == Space::Vertices ? vertexStride(block->format) : indexUnit);
+    }
+
+    // Copies `bytes` into the range, starting `byteOffset` bytes into it
+    void write(GeometryHandle handle, size_t byteOffset, size_t bytes, const void *data)
+    {
+        const Block *block = blocks.get(handle);
+        if (block == nullptr)
+        {
+            return;
+        }
+        Region &r = region(block->format, block->space);
+        r.buffer.bind();
+        r.buffer.update(block->offset * r.unit + byteOffset, bytes, data);
+    }
+
+    GLuint vertexBufferOf(VertexFormat format) const
+    {
+        return arenas[(size_t)format].vertices.buffer.id();
+    }
+
+    GLuint indexBufferOf(VertexFormat format) const
+    {
+        return arenas[(size_t)format].indices.buffer.id();
+    }
+
+    // Binds the format's VAO unless it is already current
+    void bind(VertexFormat format)
+    {
+        Arena &arena = arenas[(size_t)format];
+        if (arena.vertexArray.create() || arena.layoutDirty)
+        {
+            GLState &state = GLState::getInstance();
+            arena.vertexArray.bind();
+            state.bindBuffer(GL_ARRAY_BUFFER, arena.vertices.buffer.id());
+            specifyVertexFormat(format);
+            state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indices.buffer.id());
+            arena.layoutDirty = false;
+        }
+        else
+        {
+            arena.vertexArray.bind();
+        }
+    }
+
+    // Slides up to `maxMoves` ranges per buffer from the end of the buffer
+    // into free space nearer the start, so holes left by freed shapes merge
+    // into one tail range. Copies stay on the GPU; call once per frame.
+    size_t compact(size_t maxMoves = 4)
+    {
+        size_t moved = 0;
+        for (Arena &arena : arenas)
+        {
+            for (Region *r : {&arena.vertices, &arena.indices})
+            {
+                for (size_t i = 0; i < maxMoves && !r->owners.empty(); i++)
+                {
+                    auto last = std::prev(r->owners.end());
+                    Block *block = blocks.get(last->second);
+                    uint32_t target = r->space.allocateBelow(block->size, block->offset);
+                    if (target == OffsetAllocator::npos)
+                    {
+                        break;
+                    }
+                    GLState::getInstance().bindBuffer(GL_COPY_READ_BUFFER, r->buffer.id());
+                    GLState::getInstance().bindBuffer(GL_COPY_WRITE_BUFFER, r->buffer.id());
+                    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                        block->offset * r->unit, target * r->unit, block->size * r->unit);
+                    r->space.free(block->offset, block->size);
+                    GeometryHandle owner = last->second;
+                    r->owners.erase(last);
+                    r->owners[target] = owner;
+                    block->offset = target;
+                    bytesMoved += block->size * r->unit;
+                    moved++;
+                }
+            }
+        }
+        return moved;
+    }
+
+    GeometryPoolStats getStats() const
+    {
+        GeometryPoolStats stats = {};
+        size_t largestPerBuffer = 0;
+        for (const Arena &arena : arenas)
+        {
+            for (const Region *r : {&arena.vertices, &arena.indices})
+            {
+                stats.bufferBytes += r->space.getCapacity() * r->unit;
+                stats.usedBytes += r->space.getUsed() * r->unit;
+                size_t largest = r->space.getLargestFree() * r->unit;
+                largestPerBuffer += largest;
+                stats.largestFreeBytes = std::max(stats.largestFreeBytes, largest);
+            }
+        }
+        stats.freeBytes = stats.bufferBytes - stats.usedBytes;
+        stats.fragmentation = stats.freeBytes > 0 ? 1.0f - (float)largestPerBuffer / stats.freeBytes : 0.0f;
+        stats.allocations = blocks.size();
+        stats.bytesMoved = bytesMoved;
+        return stats;
+    }
+
+    // Hands the buffers and VAOs back; call before GpuResources::shutdown()
+    void shutdown()
+    {
+        blocks.clear();
+        for (Arena &arena : arenas)
+        {
+            for (Region *r : {&arena.vertices, &arena.indices})
+            {
+                r->buffer.release();
+                r->space = OffsetAllocator();
+                r->owners.clear();
+            }
+            arena.vertexArray.release();
+            arena.layoutDirty = true;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,411 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+struct GLCallCounts
+{
+    size_t issued = 0;
+    size_t elided = 0; // skipped because the driver already had that state
+};
+
+struct GLStateStats
+{
+    GLCallCounts programs;
+    GLCallCounts vertexArrays;
+    GLCallCounts buffers;
+    GLCallCounts uniforms;
+
+    size_t issued() const { return programs.issued + vertexArrays.issued + buffers.issued + uniforms.issued; }
+    size_t elided() const { return programs.elided + vertexArrays.elided + buffers.elided + uniforms.elided; }
+};
+
+inline GLCallCounts operator-(const GLCallCounts &a, const GLCallCounts &b)
+{
+    GLCallCounts d;
+    d.issued = a.issued - b.issued;
+    d.elided = a.elided - b.elided;
+    return d;
+}
+
+inline GLStateStats operator-(const GLStateStats &a, const GLStateStats &b)
+{
+    GLStateStats d;
+    d.programs = a.programs - b.programs;
+    d.vertexArrays = a.vertexArrays - b.vertexArrays;
+    d.buffers = a.buffers - b.buffers;
+    d.uniforms = a.uniforms - b.uniforms;
+    return d;
+}
+
+// Shadow of the context's bindings and of the uniform values set through
+// it, so calls that would not change anything never reach the driver.
+// Everything in the renderer binds programs, vertex arrays and buffers
+// through here; code that calls GL directly must call invalidate()
+// afterwards.
+//
+// GL_ELEMENT_ARRAY_BUFFER is part of the vertex array, so its shadow is
+// forgotten whenever the vertex array binding changes.
+//
+// It also keeps the constant values of generic attributes that a vertex
+// array doesn't feed from a buffer (see setAttributeDefault()). GL leaves
+// an attribute's current value undefined after a draw that sourced it
+// from an array, so every vertex array bind re-sends the defaults of the
+// attributes the previous arrays may have clobbered.
+class GLState
+{
+private:
+    static constexpr GLuint unknown = 0xFFFFFFFF;
+    static constexpr size_t indexedBindings = 8;
+    static constexpr GLuint maxAttributes = 16; // GL guarantees at least 16
+
+    enum Target
+    {
+        ArrayBuffer,
+        ElementArrayBuffer,
+        CopyReadBuffer,
+        CopyWriteBuffer,
+        UniformBuffer,
+        ShaderStorageBuffer,
+        DrawIndirectBuffer,
+        TargetCount
+    };
+
+    struct UniformValue
+    {
+        float v[16];
+        GLint components = 0; // 0 until first set
+    };
+
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLuint buffers[TargetCount] = {};
+    GLuint uniformBindings[indexedBindings] = {};
+    GLuint storageBindings[indexedBindings] = {};
+    std::vector<std::vector<UniformValue>> uniforms; // [program][location]
+    GLStateStats stats;
+
+    std::vector<uint32_t> arrayAttributes; // [vertex array] attribute bits enabled as arrays
+    float attributeDefaults[maxAttributes][4] = {};
+    uint32_t defaultedAttributes = 0; // bits with a default set
+    uint32_t staleAttributes = 0;     // bits whose current value may differ from the default
+
+    uint32_t arraysOfBound() const
+    {
+        return vertexArray < arrayAttributes.size() ? arrayAttributes[vertexArray] : 0;
+    }
+
+    // Re-sends the defaults the bound vertex array reads but earlier
+    // draws may have overwritten; its own arrays count as stale from now
+    void restoreAttributeDefaults()
+    {
+        uint32_t arrays = arraysOfBound();
+        uint32_t reset = staleAttributes & defaultedAttributes & ~arrays;
+        for (GLuint i = 0; reset != 0; i++, reset >>= 1)
+        {
+            if (reset & 1)
+            {
+                glVertexAttrib4fv(i, attributeDefaults[i]);
+                staleAttributes &= ~(1u << i);
+            }
+        }
+        staleAttributes |= arrays;
+    }
+
+    GLState() {}
+
+    static int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:
+            return ArrayBuffer;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return ElementArrayBuffer;
+        case GL_COPY_READ_BUFFER:
+            return CopyReadBuffer;
+        case GL_COPY_WRITE_BUFFER:
+            return CopyWriteBuffer;
+        case GL_UNIFORM_BUFFER:
+            return UniformBuffer;
+        case GL_SHADER_STORAGE_BUFFER:
+            return ShaderStorageBuffer;
+        case GL_DRAW_INDIRECT_BUFFER:
+            return DrawIndirectBuffer;
+        default:
+            return -1;
+        }
+    }
+
+    static bool count(GLCallCounts &counts, bool changed)
+    {
+        (changed ? counts.issued : counts.elided)++;
+        return changed;
+    }
+
+    // Shadow slot for `location` of the current program, nullptr when
+    // there is nothing to track
+    UniformValue *uniformSlot(GLint location)
+    {
+        if (location < 0 || program == 0 || program == unknown)
+        {
+            return nullptr;
+        }
+        if (uniforms.size() <= program)
+        {
+            uniforms.resize(program + 1);
+        }
+        std::vector<UniformValue> &values = uniforms[program];
+        if (values.size() <= (size_t)location)
+        {
+            values.resize(location + 1);
+        }
+        return &values[location];
+    }
+
+    bool uniformChanged(GLint location, const float *v, GLint components)
+    {
+        UniformValue *slot = uniformSlot(location);
+        if (slot == nullptr)
+        {
+            return location >= 0 && count(stats.uniforms, true);
+        }
+        size_t bytes = components * sizeof(float);
+        bool changed = slot->components != components || std::memcmp(slot->v, v, bytes) != 0;
+        if (changed)
+        {
+            std::memcpy(slot->v, v, bytes);
+            slot->components = components;
+        }
+        return count(stats.uniforms, changed);
+    }
+
+public:
+    GLState(const GLState &) = delete;
+    GLState &operator=(const GLState &) = delete;
+
+    static GLState &getInstance()
+    {
+        static GLState instance;
+        return instance;
+    }
+
+    // Returns true when glUseProgram was actually called
+    bool useProgram(GLuint name)
+    {
+        if (!count(stats.programs, program != name))
+        {
+            return false;
+        }
+        glUseProgram(name);
+        program = name;
+        return true;
+    }
+
+    void bindVertexArray(GLuint name)
+    {
+        if (count(stats.vertexArrays, vertexArray != name))
+        {
+            glBindVertexArray(name);
+            vertexArray = name;
+            buffers[ElementArrayBuffer] = unknown;
+        }
+        restoreAttributeDefaults(); // a no-op unless a default was set since
+    }
+
+    // Enable / disable a generic attribute array on the bound vertex array
+    void enableVertexAttribArray(GLuint index)
+    {
+        glEnableVertexAttribArray(index);
+        if (vertexArray != unknown)
+        {
+            if (vertexArray >= arrayAttributes.size())
+            {
+                arrayAttributes.resize(vertexArray + 1, 0);
+            }
+            arrayAttributes[vertexArray] |= 1u << index;
+        }
+        staleAttributes |= 1u << index;
+    }
+
+    void disableVertexAttribArray(GLuint index)
+    {
+        glDisableVertexAttribArray(index);
+        if (vertexArray < arrayAttributes.size())
+        {
+            arrayAttributes[vertexArray] &= ~(1u << index);
+        }
+        restoreAttributeDefaults();
+    }
+
+    // Value a vertex array that doesn't feed attribute `index` from a
+    // buffer reads for it; applied on the next vertex array bind
+    void setAttributeDefault(GLuint index, float x, float y, float z, float w)
+    {
+        float *d = attributeDefaults[index];
+        if (defaultedAttributes & (1u << index) && d[0] == x && d[1] == y && d[2] == z && d[3] == w)
+        {
+            return;
+        }
+        d[0] = x;
+        d[1] = y;
+        d[2] = z;
+        d[3] = w;
+        defaultedAttributes |= 1u << index;
+        staleAttributes |= 1u << index;
+    }
+
+    void bindBuffer(GLenum target, GLuint name)
+    {
+        int t = targetIndex(target);
+        if (!count(stats.buffers, t < 0 || buffers[t] != name))
+        {
+            return;
+        }
+        glBindBuffer(target, name);
+        if (t >= 0)
+        {
+            buffers[t] = name;
+        }
+    }
+
+    // Binds the whole buffer to an indexed uniform or storage binding
+    // point (which also sets the generic binding, as GL does)
+    void bindBufferBase(GLenum target, GLuint index, GLuint name)
+    {
+        GLuint *shadow = nullptr;
+        if (index < indexedBindings)
+        {
+            shadow = target == GL_UNIFORM_BUFFER ? &uniformBindings[index] : target == GL_SHADER_STORAGE_BUFFER ? &storageBindings[index]
+                                                                                                                 : nullptr;
+        }
+        if (!count(stats.buffers, shadow == nullptr || *shadow != name))
+        {
+            return;
+        }
+        glBindBufferBase(target, index, name);
+        if (shadow != nullptr)
+        {
+            *shadow = name;
+        }
+        int t = targetIndex(target);
+        if (t >= 0)
+        {
+            buffers[t] = name;
+        }
+    }
+
+    // Uniform setters for the current program
+    void uniform4f(GLint location, float x, float y, float z, float w)
+    {
+        float v[4] = {x, y, z, w};
+        if (uniformChanged(location, v, 4))
+        {
+            glUniform4f(location, x, y, z, w);
+        }
+    }
+
+    void uniformMatrix4(GLint location, const float *m)
+    {
+        if (uniformChanged(location, m, 16))
+        {
+            glUniformMatrix4fv(location, 1, GL_FALSE, m);
+        }
+    }
+
+    void uniformMatrix3x2(GLint location, const float *m)
+    {
+        if (uniformChanged(location, m, 6))
+        {
+            glUniformMatrix3x2fv(location, 1, GL_FALSE, m);
+        }
+    }
+
+    GLuint currentProgram() const { return program; }
+    GLuint currentVertexArray() const { return vertexArray; }
+
+    // Deleting an object unbinds it from everywhere it was bound; call
+    // these after the matching glDelete*
+    void deletedProgram(GLuint name)
+    {
+        if (program == name)
+        {
+            program = unknown; // stays current until something else is used
+        }
+        if (name < uniforms.size())
+        {
+            uniforms[name].clear();
+        }
+    }
+
+    void deletedVertexArray(GLuint name)
+    {
+        if (vertexArray == name)
+        {
+            vertexArray = 0;
+            buffers[ElementArrayBuffer] = unknown;
+        }
+        if (name < arrayAttributes.size())
+        {
+            arrayAttributes[name] = 0; // the name may be handed out again
+        }
+    }
+
+    void deletedBuffer(GLuint name)
+    {
+        for (GLuint &b : buffers)
+        {
+            if (b == name)
+            {
+                b = 0;
+            }
+        }
+        for (size_t i = 0; i < indexedBindings; i++)
+        {
+            if (uniformBindings[i] == name)
+            {
+                uniformBindings[i] = 0;
+            }
+            if (storageBindings[i] == name)
+            {
+                storageBindings[i] = 0;
+            }
+        }
+    }
+
+    // Forgets every binding and uniform value, for after GL calls made
+    // behind the tracker's back
+    void invalidate()
+    {
+        program = unknown;
+        vertexArray = unknown;
+        for (GLuint &b : buffers)
+        {
+            b = unknown;
+        }
+        for (size_t i = 0; i < indexedBindings; i++)
+        {
+            uniformBindings[i] = unknown;
+            storageBindings[i] = unknown;
+        }
+        uniforms.clear();
+        staleAttributes = defaultedAttributes;
+    }
+
+    // Starts a new set of call counts; the main loop calls this once per frame
+    void beginFrame()
+    {
+        stats = GLStateStats();
+    }
+
+    // Calls issued and elided since beginFrame()
+    const GLStateStats &getStats() const
+    {
+        return stats;
+    }
+};
+
+#endif
@@ -0,0 +1,381 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+#include "gl_state.h"
+
+// How often a buffer's contents are expected to change
+enum class BufferUsage
+{
+    Static,  // written once, drawn many times
+    Dynamic, // edited now and then, uploaded in ranges
+    Stream   // rewritten every frame, orphaned before each upload
+};
+
+inline GLenum glBufferUsage(BufferUsage usage)
+{
+    switch (usage)
+    {
+    case BufferUsage::Dynamic:
+        return GL_DYNAMIC_DRAW;
+    case BufferUsage::Stream:
+        return GL_STREAM_DRAW;
+    default:
+        return GL_STATIC_DRAW;
+    }
+}
+
+inline const char *bufferUsageName(BufferUsage usage)
+{
+    switch (usage)
+    {
+    case BufferUsage::Dynamic:
+        return "dynamic";
+    case BufferUsage::Stream:
+        return "stream";
+    default:
+        return "static";
+    }
+}
+
+// Owns every GL buffer / vertex array name the renderer hands out.
+// Objects released by their owners are not deleted straight away: they are
+// queued and handled in collect(), which the main loop calls once per frame
+// while the context is current. Released buffer names are kept in a small
+// pool (with their storage dropped) so the next allocation can reuse them.
+class GpuResources
+{
+private:
+    static constexpr size_t maxPooledBuffers = 64;
+
+    std::vector<GLuint> pendingBuffers;
+    std::vector<GLuint> pendingImmutableBuffers; // can't drop their storage, so never pooled
+    std::vector<GLuint> pendingVertexArrays;
+    std::vector<GLuint> pooledBuffers;
+
+    size_t liveBuffers = 0;
+    size_t liveVertexArrays = 0;
+    size_t bufferBytes = 0;
+    size_t uploadedBytes = 0;
+
+    GpuResources() {}
+
+public:
+    GpuResources(const GpuResources &) = delete;
+    GpuResources &operator=(const GpuResources &) = delete;
+
+    static GpuResources &getInstance()
+    {
+        static GpuResources instance;
+        return instance;
+    }
+
+    GLuint createBuffer()
+    {
+        GLuint name = 0;
+        if (!pooledBuffers.empty())
+        {
+            name = pooledBuffers.back();
+            pooledBuffers.pop_back();
+        }
+        else
+        {
+            glGenBuffers(1, &name);
+        }
+        liveBuffers++;
+        return name;
+    }
+
+    GLuint createVertexArray()
+    {
+        GLuint name = 0;
+        glGenVertexArrays(1, &name);
+        liveVertexArrays++;
+        return name;
+    }
+
+    void releaseBuffer(GLuint name, size_t bytes, bool immutable = false)
+    {
+        (immutable ? pendingImmutableBuffers : pendingBuffers).push_back(name);
+        liveBuffers--;
+        bufferBytes -= bytes;
+    }
+
+    void releaseVertexArray(GLuint name)
+    {
+        pendingVertexArrays.push_back(name);
+        liveVertexArrays--;
+    }
+
+    void resizeBuffer(size_t oldBytes, size_t newBytes)
+    {
+        bufferBytes = bufferBytes - oldBytes + newBytes;
+    }
+
+    void recordUpload(size_t bytes)
+    {
+        uploadedBytes += bytes;
+    }
+
+    // Deletes (or pools) everything released since the last call
+    void collect()
+    {
+        GLState &state = GLState::getInstance();
+        if (!pendingVertexArrays.empty())
+        {
+            glDeleteVertexArrays((GLsizei)pendingVertexArrays.size(), pendingVertexArrays.data());
+            for (GLuint name : pendingVertexArrays)
+            {
+                state.deletedVertexArray(name);
+            }
+            pendingVertexArrays.clear();
+        }
+
+        for (GLuint name : pendingBuffers)
+        {
+            if (pooledBuffers.size() < maxPooledBuffers)
+            {
+                state.bindBuffer(GL_ARRAY_BUFFER, name);
+                glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW); // drop the storage, keep the name
+                pooledBuffers.push_back(name);
+            }
+            else
+            {
+                glDeleteBuffers(1, &name);
+                state.deletedBuffer(name);
+            }
+        }
+        pendingBuffers.clear();
+
+        for (GLuint name : pendingImmutableBuffers)
+        {
+            glDeleteBuffers(1, &name);
+            state.deletedBuffer(name);
+        }
+        pendingImmutableBuffers.clear();
+    }
+
+    // Deletes pooled names too; call before the context goes away
+    void shutdown()
+    {
+        collect();
+        if (!pooledBuffers.empty())
+        {
+            glDeleteBuffers((GLsizei)pooledBuffers.size(), pooledBuffers.data());
+            for (GLuint name : pooledBuffers)
+            {
+                GLState::getInstance().deletedBuffer(name);
+            }
+            pooledBuffers.clear();
+        }
+    }
+
+    size_t getLiveBuffers() const { return liveBuffers; }
+    size_t getLiveVertexArrays() const { return liveVertexArrays; }
+    size_t getBufferBytes() const { return bufferBytes; }
+    size_t getUploadedBytes() const { return uploadedBytes; }
+    size_t getPendingCount() const { return pendingBuffers.size() + pendingImmutableBuffers.size() + pendingVertexArrays.size(); }
+    size_t getPooledBuffers() const { return pooledBuffers.size(); }
+};
+
+// Move-only owner of one GL buffer object
+class GpuBuffer
+{
+private:
+    GLuint name = 0;
+    GLenum target;
+    GLenum usage = GL_STATIC_DRAW;
+    size_t size = 0;
+    bool immutable = false; // storage from setStorage()
+
+public:
+    explicit GpuBuffer(GLenum target = GL_ARRAY_BUFFER) : target(target) {}
+    ~GpuBuffer() { release(); }
+
+    GpuBuffer(const GpuBuffer &) = delete;
+    GpuBuffer &operator=(const GpuBuffer &) = delete;
+
+    GpuBuffer(GpuBuffer &&other) noexcept : name(other.name), target(other.target), usage(other.usage), size(other.size),
+                                            immutable(other.immutable)
+    {
+        other.name = 0;
+        other.size = 0;
+        other.immutable = false;
+    }
+
+    GpuBuffer &operator=(GpuBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            name = other.name;
+            target = other.target;
+            usage = other.usage;
+            size = other.size;
+            immutable = other.immutable;
+            other.name = 0;
+            other.size = 0;
+            other.immutable = false;
+        }
+        return *this;
+    }
+
+    void bind() const
+    {
+        GLState::getInstance().bindBuffer(target, name);
+    }
+
+    // (Re)allocates the storage, creating the buffer name on first use.
+    // Leaves the buffer bound to its target.
+    void setData(size_t bytes, const void *data, GLenum usage)
+    {
+        if (name == 0)
+        {
+            name = GpuResources::getInstance().createBuffer();
+        }
+        bind();
+        glBufferData(target, bytes, data, usage);
+        GpuResources::getInstance().resizeBuffer(size, bytes);
+        if (data != nullptr)
+        {
+            GpuResources::getInstance().recordUpload(bytes);
+        }
+        size = bytes;
+        this->usage = usage;
+    }
+
+    // Allocates immutable storage (glBufferStorage, GL 4.4) with the given
+    // GL_MAP_*/GL_DYNAMIC_STORAGE_BIT flags. It can't be resized or
+    // orphaned afterwards; release() and allocate again instead.
+    void setStorage(size_t bytes, GLbitfield flags)
+    {
+        if (name == 0)
+        {
+            name = GpuResources::getInstance().createBuffer();
+        }
+        bind();
+        glBufferStorage(target, bytes, nullptr, flags);
+        GpuResources::getInstance().resizeBuffer(size, bytes);
+        size = bytes;
+        immutable = true;
+    }
+
+    // Makes room for at least `bytes`, growing geometrically. Returns true
+    // when the storage was reallocated, in which case its contents are gone
+    // and the caller has to upload everything again. Leaves the buffer bound.
+    bool reserve(size_t bytes, GLenum usage)
+    {
+        if (name != 0 && bytes <= size)
+        {
+            bind();
+            return false;
+        }
+        size_t grown = size * 2;
+        setData(bytes > grown ? bytes : grown, nullptr, usage);
+        return true;
+    }
+
+    // Copies into [offset, offset + bytes) of the existing storage.
+    // Expects the buffer to be bound (reserve() leaves it bound).
+    void update(size_t offset, size_t bytes, const void *data)
+    {
+        if (bytes == 0)
+        {
+            return;
+        }
+        glBufferSubData(target, offset, bytes, data);
+        GpuResources::getInstance().recordUpload(bytes);
+    }
+
+    // Detaches the current storage from the buffer name so the next write
+    // does not wait for draws still reading the old contents
+    void orphan()
+    {
+        bind();
+        glBufferData(target, size, nullptr, usage);
+    }
+
+    void release()
+    {
+        if (name != 0)
+        {
+            GpuResources::getInstance().releaseBuffer(name, size, immutable);
+            name = 0;
+            size = 0;
+            immutable = false;
+        }
+    }
+
+    bool valid() const { return name != 0; }
+    GLuint id() const { return name; }
+    GLenum getTarget() const { return target; }
+    size_t getSize() const { return size; }
+};
+
+// Move-only owner of one vertex array object
+class VertexArray
+{
+private:
+    GLuint name = 0;
+
+public:
+    VertexArray() {}
+    ~VertexArray() { release(); }
+
+    VertexArray(const VertexArray &) = delete;
+    VertexArray &operator=(const VertexArray &) = delete;
+
+    VertexArray(VertexArray &&other) noexcept : name(other.name)
+    {
+        other.name = 0;
+    }
+
+    VertexArray &operator=(VertexArray &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            name = other.name;
+            other.name = 0;
+        }
+        return *this;
+    }
+
+    // Returns true when a new name was created, i.e. the attribute layout
+    // still has to be specified
+    bool create()
+    {
+        if (name != 0)
+        {
+            return false;
+        }
+        name = GpuResources::getInstance().createVertexArray();
+        return true;
+    }
+
+    void bind() const
+    {
+        GLState::getInstance().bindVertexArray(name);
+    }
+
+    static void unbind()
+    {
+        GLState::getInstance().bindVertexArray(0);
+    }
+
+    void release()
+    {
+        if (name != 0)
+        {
+            GpuResources::getInstance().releaseVertexArray(name);
+            name = 0;
+        }
+    }
+
+    bool valid() const { return name != 0; }
+    GLuint id() const { return name; }
+};
+
+#endif
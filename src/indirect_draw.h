@@ -0,0 +1,399 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "vector.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "geometry_pool.h"
+#include "shader.h"
+
+// Layouts glMultiDraw*Indirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance; // index into the per-draw data, see IndirectRenderer
+};
+
+struct DrawArraysIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+// Submits GeometryPool ranges with a few glMultiDraw*Indirect calls per
+// frame instead of one draw per shape (needs GL 4.3).
+//
+// Every queued draw gets a slot in a shader storage buffer holding its
+// model matrix and color:
+//
+//     struct DrawData { mat4 model; vec4 color; };
+//     layout (std430, binding = 1) readonly buffer Draws { DrawData draws[]; };
+//     layout (location = 7) in uint aDrawId;
+//
+// A program for a 2D scene may declare `mat3x2 model` instead (48 bytes a
+// draw instead of 80); the World then queues Mat3x2 models.
+//
+// Its command's baseInstance is that slot, and aDrawId is an instanced
+// attribute over the sequence 0, 1, 2, ..., so the shader reads
+// draws[aDrawId] without needing gl_DrawID (GL 4.6).
+//
+// Commands are grouped by vertex format and index type, one call per
+// group, so the call count stays the same however many draws are queued.
+// Within a run of commands the order follows the groups rather than the
+// queue order; breakGroups() ends the run, so nothing added later is drawn
+// before anything added earlier (the World breaks at every layer change).
+// External entries (things the caller draws itself) also break the run
+// and are drawn at their place in the queue.
+class IndirectRenderer
+{
+public:
+    static constexpr GLuint drawDataBinding = 1;
+
+private:
+    struct DrawData
+    {
+        float model[16];
+        Vector4A color;
+    };
+    static_assert(sizeof(DrawData) == 80, "DrawData must match the std430 struct");
+
+    // std430 lays the mat3x2 out as three vec2 columns, and the vec4 after
+    // it starts on the next 16 bytes
+    struct DrawData2D
+    {
+        float model[6];
+        float pad[2];
+        Vector4A color;
+    };
+    static_assert(sizeof(DrawData2D) == 48 && offsetof(DrawData2D, color) == 32, "DrawData2D must match the std430 struct");
+
+    // Commands sharing one call: a format with 16-bit indices, 32-bit
+    // indices, or no indices
+    struct Bucket
+    {
+        std::vector<DrawElementsIndirectCommand> elements;
+        std::vector<DrawArraysIndirectCommand> arrays;
+    };
+
+    // What submit() does, in order: one multi-draw call over a closed
+    // bucket's commands, or one external entry
+    struct Step
+    {
+        bool external;
+        uint32_t token;         // external entries
+        uint32_t bucket;        // calls
+        uint32_t commandCount;
+        size_t byteOffset;      // where the commands start in commandBuffer
+    };
+
+    static constexpr size_t formatCount = vertexFormatCount;
+    static constexpr size_t bucketsPerFormat = 3;
+
+    ShaderProgram *program = nullptr;
+    const ShaderProgram *restoreProgram = nullptr;
+
+    Bucket buckets[formatCount * bucketsPerFormat];
+    std::vector<DrawData> drawData;
+    std::vector<DrawData2D> drawData2D; // used instead when the program takes 2D models
+    std::vector<Step> steps;
+    std::vector<uint8_t> commandStaging;
+    bool groupsOpen = false; // buckets hold commands not yet turned into steps
+
+    GpuBuffer commandBuffer = GpuBuffer(GL_DRAW_INDIRECT_BUFFER);
+    GpuBuffer dataBuffer = GpuBuffer(GL_SHADER_STORAGE_BUFFER);
+    GpuBuffer drawIdBuffer;
+    uint32_t drawIdCount = 0;
+
+    // Same layout as the pool's VAO for the format plus aDrawId
+    VertexArray vertexArrays[formatCount];
+    GLuint specifiedVertexBuffer[formatCount] = {};
+    GLuint specifiedIndexBuffer[formatCount] = {};
+
+    size_t lastCalls = 0;
+
+    static size_t bucketIndex(VertexFormat format, GLenum indexType)
+    {
+        size_t kind = indexType == GL_UNSIGNED_SHORT ? 0 : indexType == GL_UNSIGNED_INT ? 1
+                                                                                         : 2;
+        return (size_t)format * bucketsPerFormat + kind;
+    }
+
+    // Makes sure aDrawId can address every draw queued this frame
+    void reserveDrawIds(uint32_t count)
+    {
+        if (count <= drawIdCount)
+        {
+            return;
+        }
+        uint32_t grown = std::max(count, drawIdCount * 2);
+        std::vector<uint32_t> ids(grown);
+        for (uint32_t i = 0; i < grown; i++)
+        {
+            ids[i] = i;
+        }
+        drawIdBuffer.setData(ids.size() * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+        drawIdCount = grown;
+    }
+
+    void bindFormat(VertexFormat format)
+    {
+        size_t f = (size_t)format;
+        GeometryPool &pool = GeometryPool::getInstance();
+        GLuint vertexBuffer = pool.vertexBufferOf(format);
+        GLuint indexBuffer = pool.indexBufferOf(format);
+        if (vertexArrays[f].create() || specifiedVertexBuffer[f] != vertexBuffer || specifiedIndexBuffer[f] != indexBuffer)
+        {
+            GLState &state = GLState::getInstance();
+            vertexArrays[f].bind();
+            state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            specifyVertexFormat(format);
+            state.bindBuffer(GL_ARRAY_BUFFER, drawIdBuffer.id());
+            glVertexAttribIPointer(ShaderProgram::drawIdAttribute, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void *)0);
+            glEnableVertexAttribArray(ShaderProgram::drawIdAttribute);
+            glVertexAttribDivisor(ShaderProgram::drawIdAttribute, 1);
+            state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            specifiedVertexBuffer[f] = vertexBuffer;
+            specifiedIndexBuffer[f] = indexBuffer;
+        }
+        else
+        {
+            vertexArrays[f].bind();
+        }
+    }
+
+    static size_t indexSize(GLenum indexType)
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    template <typename T>
+    void stageCommands(const std::vector<T> &commands)
+    {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(commands.data());
+        commandStaging.insert(commandStaging.end(), bytes, bytes + commands.size() * sizeof(T));
+    }
+
+    // Uploads the commands closed into commandStaging and the draw data
+    void upload()
+    {
+        reserveDrawIds((uint32_t)drawCount());
+
+        bool model2D = !drawData2D.empty();
+        size_t dataBytes = model2D ? drawData2D.size() * sizeof(DrawData2D) : drawData.size() * sizeof(DrawData);
+        if (!dataBuffer.reserve(dataBytes, GL_STREAM_DRAW))
+        {
+            dataBuffer.orphan();
+        }
+        dataBuffer.update(0, dataBytes, model2D ? (const void *)drawData2D.data() : drawData.data());
+        GLState::getInstance().bindBufferBase(GL_SHADER_STORAGE_BUFFER, drawDataBinding, dataBuffer.id());
+
+        if (!commandBuffer.reserve(commandStaging.size(), GL_STREAM_DRAW))
+        {
+            commandBuffer.orphan();
+        }
+        commandBuffer.update(0, commandStaging.size(), commandStaging.data());
+    }
+
+public:
+    // True when the context exposes glMultiDraw*Indirect and storage buffers
+    static bool supported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // `program` reads the per-draw data as described above; `restore` is
+    // made current again afterwards for the shapes drawn normally
+    void setProgram(ShaderProgram *indirectProgram, const ShaderProgram *restore)
+    {
+        program = indirectProgram;
+        restoreProgram = restore;
+    }
+
+    ShaderProgram *getProgram() const
+    {
+        return program;
+    }
+
+    void begin()
+    {
+        for (Bucket &bucket : buckets)
+        {
+            bucket.elements.clear();
+            bucket.arrays.clear();
+        }
+        drawData.clear();
+        drawData2D.clear();
+        steps.clear();
+        commandStaging.clear();
+        groupsOpen = false;
+    }
+
+    // Turns the open groups into one call each; commands added afterwards
+    // are drawn after all of them
+    void breakGroups()
+    {
+        if (!groupsOpen)
+        {
+            return;
+        }
+        for (uint32_t b = 0; b < formatCount * bucketsPerFormat; b++)
+        {
+            Bucket &bucket = buckets[b];
+            if (bucket.elements.empty() && bucket.arrays.empty())
+            {
+                continue;
+            }
+            Step step = {};
+            step.bucket = b;
+            step.byteOffset = commandStaging.size();
+            step.commandCount = (uint32_t)(bucket.elements.size() + bucket.arrays.size()); // a bucket holds one kind
+            stageCommands(bucket.elements);
+            stageCommands(bucket.arrays);
+            steps.push_back(step);
+            bucket.elements.clear();
+            bucket.arrays.clear();
+        }
+        groupsOpen = false;
+    }
+
+    // Stores a draw's model and color, returning the slot to pass to
+    // addElements/addArrays. The program decides which form it reads
+    // (ShaderProgram::takesModel2D()); one frame uses only one of them.
+    uint32_t addDraw(const Mat4 &model, const Vector4 &color)
+    {
+        DrawData data;
+        std::copy(model.m, model.m + 16, data.model);
+        data.color = color;
+        drawData.push_back(data);
+        return (uint32_t)drawData.size() - 1;
+    }
+
+    uint32_t addDraw(const Mat3x2 &model, const Vector4 &color)
+    {
+        DrawData2D data = {};
+        std::copy(model.m, model.m + 6, data.model);
+        data.color = color;
+        drawData2D.push_back(data);
+        return (uint32_t)drawData2D.size() - 1;
+    }
+
+    size_t drawCount() const
+    {
+        return drawData.size() + drawData2D.size();
+    }
+
+    // Queues an indexed range: `count` indices starting `indexByteOffset`
+    // into the format's index buffer, relative to `baseVertex`
+    void addElements(VertexFormat format, GLenum indexType, uint32_t count, size_t indexByteOffset,
+                     int32_t baseVertex, uint32_t draw)
+    {
+        DrawElementsIndirectCommand cmd;
+        cmd.count = count;
+        cmd.instanceCount = 1;
+        cmd.firstIndex = (GLuint)(indexByteOffset / indexSize(indexType));
+        cmd.baseVertex = baseVertex;
+        cmd.baseInstance = draw;
+        buckets[bucketIndex(format, indexType)].elements.push_back(cmd);
+        groupsOpen = true;
+    }
+
+    void addArrays(VertexFormat format, uint32_t count, uint32_t firstVertex, uint32_t draw)
+    {
+        DrawArraysIndirectCommand cmd;
+        cmd.count = count;
+        cmd.instanceCount = 1;
+        cmd.first = firstVertex;
+        cmd.baseInstance = draw;
+        buckets[bucketIndex(format, 0)].arrays.push_back(cmd);
+        groupsOpen = true;
+    }
+
+    // Something the caller draws itself, after everything added so far;
+    // `token` is passed back to the submit() callback
+    void addExternal(uint32_t token)
+    {
+        breakGroups();
+        Step step = {};
+        step.external = true;
+        step.token = token;
+        steps.push_back(step);
+    }
+
+    // Uploads the frame's commands and draw data, then goes through the
+    // steps in order: one call per closed group, drawExternal(token) for
+    // each external
+    template <typename DrawExternal>
+    void submit(DrawExternal &&drawExternal)
+    {
+        lastCalls = 0;
+        breakGroups();
+        if (drawCount() > 0)
+        {
+            upload();
+        }
+        bool indirectCurrent = false; // externals switch to their own program
+        for (const Step &step : steps)
+        {
+            if (step.external)
+            {
+                drawExternal(step.token);
+                indirectCurrent = false;
+                continue;
+            }
+            if (!indirectCurrent)
+            {
+                program->use();
+                indirectCurrent = true;
+            }
+            bindFormat((VertexFormat)(step.bucket / bucketsPerFormat));
+            commandBuffer.bind();
+            size_t kind = step.bucket % bucketsPerFormat;
+            if (kind < 2)
+            {
+                GLenum indexType = kind == 0 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+                glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void *)step.byteOffset, (GLsizei)step.commandCount, 0);
+            }
+            else
+            {
+                glMultiDrawArraysIndirect(GL_TRIANGLES, (void *)step.byteOffset, (GLsizei)step.commandCount, 0);
+            }
+            lastCalls++;
+        }
+        if (indirectCurrent && restoreProgram != nullptr)
+        {
+            restoreProgram->use();
+        }
+    }
+
+    // glMultiDraw*Indirect calls issued by the last submit()
+    size_t getLastCallCount() const
+    {
+        return lastCalls;
+    }
+
+    void release()
+    {
+        commandBuffer.release();
+        dataBuffer.release();
+        drawIdBuffer.release();
+        drawIdCount = 0;
+        for (size_t f = 0; f < formatCount; f++)
+        {
+            vertexArrays[f].release();
+            specifiedVertexBuffer[f] = 0;
+            specifiedIndexBuffer[f] = 0;
+        }
+    }
+};
+
+#endif
@@ -11,53 +11,111 @@ Task mainTask = Task();
 
 const char *vertexShaderSrc = R"(
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec2 aPos; // the scene is flat; see World::set2DMode
+layout (location = 1) in vec4 aColor;
 
-uniform mat4 uMVP;
+layout (std140) uniform Frame {
+    mat4 uViewProj;
+};
+uniform mat3x2 uModel; // 2D affine, see ShaderProgram::takesModel2D
+
+out vec4 vColor;
+
+void main() {
+    gl_Position = uViewProj * vec4(uModel * vec3(aPos, 1.0), 0.0, 1.0);
+    vColor = aColor;
+}
+
+)";
+
+// For InstancedShape programs: adds the per-instance transform and color,
+// which plain shapes would only multiply by their identity defaults
+const char *instancedVertexShaderSrc = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec4 aColor;
+layout (location = 2) in mat3x2 aInstanceModel; // locations 2-4
+layout (location = 6) in vec4 aInstanceColor;
+
+layout (std140) uniform Frame {
+    mat4 uViewProj;
+};
+uniform mat3x2 uModel;
+
+out vec4 vColor;
 
 void main() {
-    gl_Position = uMVP * vec4(aPos, 1.0);
+    vec2 local = aInstanceModel * vec3(aPos, 1.0);
+    gl_Position = uViewProj * vec4(uModel * vec3(local, 1.0), 0.0, 1.0);
+    vColor = aColor * aInstanceColor;
 }
 
 )";
 
 const char *fragmentShaderSrc = R"(
 #version 330 core
+in vec4 vColor;
 out vec4 FragColor;
 
 uniform vec4 uColor;
 
 void main() {
-    FragColor = uColor;
+    FragColor = uColor * vColor;
 }
 
 
 )";
 
-GLuint init_shaders()
-{
-    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+// Same output for pooled shapes submitted with glMultiDraw*Indirect: the
+// model matrix and color come from the per-draw storage buffer
+const char *indirectVertexShaderSrc = R"(
+#version 430 core
+layout (location = 0) in vec2 aPos; // the scene is flat; see World::set2DMode
+layout (location = 1) in vec4 aColor;
+layout (location = 7) in uint aDrawId;
+
+layout (std140) uniform Frame {
+    mat4 uViewProj;
+};
+
+struct DrawData {
+    mat3x2 model;
+    vec4 color;
+};
+layout (std430, binding = 1) readonly buffer Draws {
+    DrawData draws[];
+};
+
+out vec4 vColor;
+
+void main() {
+    DrawData draw = draws[aDrawId];
+    gl_Position = uViewProj * vec4(draw.model * vec3(aPos, 1.0), 0.0, 1.0);
+    vColor = draw.color * aColor;
+}
+
+)";
 
-    GLuint vert = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert, 1, &vertexShaderSrc, nullptr);
-    glCompileShader(vert);
+const char *indirectFragmentShaderSrc = R"(
+#version 430 core
+in vec4 vColor;
+out vec4 FragColor;
+
+void main() {
+    FragColor = vColor;
+}
 
-    GLuint frag = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag, 1, &fragmentShaderSrc, nullptr);
-    glCompileShader(frag);
 
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vert);
-    glAttachShader(shaderProgram, frag);
-    glLinkProgram(shaderProgram);
+)";
 
-    glDeleteShader(vert);
-    glDeleteShader(frag);
+ShaderProgram *init_shaders()
+{
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
-    return shaderProgram;
+    return new ShaderProgram(vertexShaderSrc, fragmentShaderSrc);
 }
 
-void init_scene(GLFWwindow *window, GLuint shaderProgram)
+void init_scene(GLFWwindow *window, ShaderProgram *shaderProgram)
 {
     World &world = World::getInstance();
     Shape *square = new Shape(window, shaderProgram);
@@ -78,6 +136,7 @@ void init_scene(GLFWwindow *window, GLuint shaderProgram)
     hexagon->translate(Vector3(20.0f, 20.0f, 0.0f));
 
     world.bindShape("hexagon", hexagon);
+    world.setStatic(hexagon, true); // scenery, never moves
     world.bindShape("player", character);
 
     delete square;
@@ -97,10 +156,21 @@ int main()
 
     init_done = true;
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // 4.4 adds the persistent-mapped stream ring, 4.3 multi-draw-indirect
+    // submission; 3.3 draws shape by shape
+    const int versions[][2] = {{4, 4}, {4, 3}, {3, 3}};
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    GLFWwindow *window = glfwCreateWindow(800, 800, "Walk around the room", NULL, NULL);
+    GLFWwindow *window = NULL;
+    for (const auto &version : versions)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(800, 800, "Walk around the room", NULL, NULL);
+        if (window)
+        {
+            break;
+        }
+    }
 
     if (!window)
     {
@@ -118,20 +188,30 @@ int main()
         return -1;
     }
 
-    GLuint shaderProgram = init_shaders();
+    ShaderProgram *shaderProgram = init_shaders();
 
     World &world = World::getInstance();
 
     world.setWorldSize(Vector3(50, 50, 50));
+    world.setCollisionResponse(CollisionResponse::Clip);
+    world.set2DMode(true); // every shape lies in the z = 0 plane
+
+    ShaderProgram *indirectProgram = nullptr;
+    if (IndirectRenderer::supported())
+    {
+        indirectProgram = new ShaderProgram(indirectVertexShaderSrc, indirectFragmentShaderSrc);
+        world.setMultiDrawProgram(indirectProgram, shaderProgram);
+    }
 
     init_scene(window, shaderProgram);
+    NameId playerName = world.internName("player");
 
     while (!glfwWindowShouldClose(window))
     {
+        GLState::getInstance().beginFrame();
         glClear(GL_COLOR_BUFFER_BIT);
-        glUseProgram(shaderProgram);
-        world.drawAllShapes();
-        Shape *player = world.getShape("player");
+        world.drawAllShapes(); // makes each shape's program current as needed
+        Shape *player = world.findShape(playerName);
         if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
             player->translate(Vector3(0.0f, 0.15f, 0.0f));
         if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
@@ -143,8 +223,16 @@ int main()
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+        GpuResources::getInstance().collect();
+        GeometryPool::getInstance().compact();
     }
 
+    world.disableMultiDraw();
+    delete indirectProgram;
+    delete shaderProgram;
+    StreamRing::getInstance().shutdown();
+    GeometryPool::getInstance().shutdown();
+    GpuResources::getInstance().shutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
@@ -0,0 +1,515 @@
+#ifndef MAT4_KERNELS_H
+#define MAT4_KERNELS_H
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAT4_KERNELS_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define MAT4_KERNELS_AVX2 1 // compiled with a target attribute, picked at runtime
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define MAT4_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// 4x4 matrix kernels behind Mat4, on plain column-major float[16] (as
+// OpenGL stores them, m[col * 4 + row]). Every kernel has a scalar
+// version and, where the compiler and CPU allow, SSE2 / AVX2 / NEON ones;
+// the fastest the CPU supports is chosen the first time one is needed.
+// Outputs must not alias inputs.
+//
+// The SIMD versions of multiply() and transform() add the products in
+// the same order as the scalar ones, so without FMA contraction they
+// give bit-identical results. inverse() and affineInverse() evaluate
+// their cofactors in a different order and agree to rounding.
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+inline const char *simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::NEON:
+        return "neon";
+    default:
+        return "scalar";
+    }
+}
+
+struct Mat4Kernels
+{
+    SimdLevel level;
+    void (*multiply)(const float *a, const float *b, float *out);  // out = a * b
+    void (*transform)(const float *m, const float *v, float *out); // out = m * v for a vec4 v
+    void (*transpose)(const float *m, float *out);
+    bool (*inverse)(const float *m, float *out);       // false (out untouched) when singular
+    bool (*affineInverse)(const float *m, float *out); // m's bottom row must be 0 0 0 1
+};
+
+// Scalar kernels, always available and the reference for the others
+
+inline void mat4MultiplyScalar(const float *a, const float *b, float *out)
+{
+    for (int col = 0; col < 4; col++)
+        for (int row = 0; row < 4; row++)
+            out[col * 4 + row] =
+                a[0 * 4 + row] * b[col * 4 + 0] +
+                a[1 * 4 + row] * b[col * 4 + 1] +
+                a[2 * 4 + row] * b[col * 4 + 2] +
+                a[3 * 4 + row] * b[col * 4 + 3];
+}
+
+inline void mat4TransformScalar(const float *m, const float *v, float *out)
+{
+    for (int row = 0; row < 4; row++)
+        out[row] = m[0 * 4 + row] * v[0] + m[1 * 4 + row] * v[1] + m[2 * 4 + row] * v[2] + m[3 * 4 + row] * v[3];
+}
+
+inline void mat4TransposeScalar(const float *m, float *out)
+{
+    for (int col = 0; col < 4; col++)
+        for (int row = 0; row < 4; row++)
+            out[row * 4 + col] = m[col * 4 + row];
+}
+
+// Cofactor expansion through the 2x2 minors of the top and bottom halves
+inline bool mat4InverseScalar(const float *m, float *out)
+{
+    // Rows of the top half are columns 0..3 at rows 0, 1; bottom rows 2, 3
+    float s0 = m[0] * m[5] - m[4] * m[1];
+    float s1 = m[0] * m[9] - m[8] * m[1];
+    float s2 = m[0] * m[13] - m[12] * m[1];
+    float s3 = m[4] * m[9] - m[8] * m[5];
+    float s4 = m[4] * m[13] - m[12] * m[5];
+    float s5 = m[8] * m[13] - m[12] * m[9];
+
+    float c5 = m[10] * m[15] - m[14] * m[11];
+    float c4 = m[6] * m[15] - m[14] * m[7];
+    float c3 = m[6] * m[11] - m[10] * m[7];
+    float c2 = m[2] * m[15] - m[14] * m[3];
+    float c1 = m[2] * m[11] - m[10] * m[3];
+    float c0 = m[2] * m[7] - m[6] * m[3];
+
+    float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == 0.0f || !std::isfinite(det))
+    {
+        return false;
+    }
+    float inv = 1.0f / det;
+
+    out[0] = (m[5] * c5 - m[9] * c4 + m[13] * c3) * inv;
+    out[4] = (-m[4] * c5 + m[8] * c4 - m[12] * c3) * inv;
+    out[8] = (m[7] * s5 - m[11] * s4 + m[15] * s3) * inv;
+    out[12] = (-m[6] * s5 + m[10] * s4 - m[14] * s3) * inv;
+
+    out[1] = (-m[1] * c5 + m[9] * c2 - m[13] * c1) * inv;
+    out[5] = (m[0] * c5 - m[8] * c2 + m[12] * c1) * inv;
+    out[9] = (-m[3] * s5 + m[11] * s2 - m[15] * s1) * inv;
+    out[13] = (m[2] * s5 - m[10] * s2 + m[14] * s1) * inv;
+
+    out[2] = (m[1] * c4 - m[5] * c2 + m[13] * c0) * inv;
+    out[6] = (-m[0] * c4 + m[4] * c2 - m[12] * c0) * inv;
+    out[10] = (m[3] * s4 - m[7] * s2 + m[15] * s0) * inv;
+    out[14] = (-m[2] * s4 + m[6] * s2 - m[14] * s0) * inv;
+
+    out[3] = (-m[1] * c3 + m[5] * c1 - m[9] * c0) * inv;
+    out[7] = (m[0] * c3 - m[4] * c1 + m[8] * c0) * inv;
+    out[11] = (-m[3] * s3 + m[7] * s1 - m[11] * s0) * inv;
+    out[15] = (m[2] * s3 - m[6] * s1 + m[10] * s0) * inv;
+    return true;
+}
+
+// Inverts the upper 3x3 through cross products of its columns and moves
+// the translation back through it: about a third of the general inverse
+inline bool mat4AffineInverseScalar(const float *m, float *out)
+{
+    const float *c0 = m, *c1 = m + 4, *c2 = m + 8, *t = m + 12;
+    // Rows of the inverse are c1 x c2, c2 x c0, c0 x c1 over the determinant
+    float r0[3] = {c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2], c1[0] * c2[1] - c1[1] * c2[0]};
+    float r1[3] = {c2[1] * c0[2] - c2[2] * c0[1], c2[2] * c0[0] - c2[0] * c0[2], c2[0] * c0[1] - c2[1] * c0[0]};
+    float r2[3] = {c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2], c0[0] * c1[1] - c0[1] * c1[0]};
+    float det = c0[0] * r0[0] + c0[1] * r0[1] + c0[2] * r0[2];
+    if (det == 0.0f || !std::isfinite(det))
+    {
+        return false;
+    }
+    float inv = 1.0f / det;
+    const float *rows[3] = {r0, r1, r2};
+    for (int row = 0; row < 3; row++)
+    {
+        const float *r = rows[row];
+        out[0 * 4 + row] = r[0] * inv;
+        out[1 * 4 + row] = r[1] * inv;
+        out[2 * 4 + row] = r[2] * inv;
+        out[3 * 4 + row] = -(r[0] * t[0] + r[1] * t[1] + r[2] * t[2]) * inv;
+    }
+    out[3] = out[7] = out[11] = 0.0f;
+    out[15] = 1.0f;
+    return true;
+}
+
+// SIMD kernels are written once against an ops struct B per instruction
+// set, providing V (one 4-lane register), load, store, splat, add, sub,
+// mul, swapPairs (y x w z), swapHalves (z w x y), sum of all lanes, sum3
+// of x y z, cross on x y z (w comes out 0), transpose4 of four registers
+// and a transposing load.
+
+template <typename B>
+inline bool mat4InverseSimd(const float *m, float *out)
+{
+    typedef typename B::V V;
+    // Streaming SIMD Extensions - Inverse of 4x4 Matrix (Intel AP-928),
+    // on the columns; the transposed problem has the transposed answer
+    V row0, row1, row2, row3;
+    B::transpose(m, row0, row1, row2, row3);
+    row1 = B::swapHalves(row1);
+    row3 = B::swapHalves(row3);
+
+    V tmp = B::swapPairs(B::mul(row2, row3));
+    V minor0 = B::mul(row1, tmp);
+    V minor1 = B::mul(row0, tmp);
+    tmp = B::swapHalves(tmp);
+    minor0 = B::sub(B::mul(row1, tmp), minor0);
+    minor1 = B::swapHalves(B::sub(B::mul(row0, tmp), minor1));
+
+    tmp = B::swapPairs(B::mul(row1, row2));
+    minor0 = B::add(B::mul(row3, tmp), minor0);
+    V minor3 = B::mul(row0, tmp);
+    tmp = B::swapHalves(tmp);
+    minor0 = B::sub(minor0, B::mul(row3, tmp));
+    minor3 = B::swapHalves(B::sub(B::mul(row0, tmp), minor3));
+
+    tmp = B::swapPairs(B::mul(B::swapHalves(row1), row3));
+    row2 = B::swapHalves(row2);
+    minor0 = B::add(B::mul(row2, tmp), minor0);
+    V minor2 = B::mul(row0, tmp);
+    tmp = B::swapHalves(tmp);
+    minor0 = B::sub(minor0, B::mul(row2, tmp));
+    minor2 = B::swapHalves(B::sub(B::mul(row0, tmp), minor2));
+
+    tmp = B::swapPairs(B::mul(row0, row1));
+    minor2 = B::add(B::mul(row3, tmp), minor2);
+    minor3 = B::sub(B::mul(row2, tmp), minor3);
+    tmp = B::swapHalves(tmp);
+    minor2 = B::sub(B::mul(row3, tmp), minor2);
+    minor3 = B::sub(minor3, B::mul(row2, tmp));
+
+    tmp = B::swapPairs(B::mul(row0, row3));
+    minor1 = B::sub(minor1, B::mul(row2, tmp));
+    minor2 = B::add(B::mul(row1, tmp), minor2);
+    tmp = B::swapHalves(tmp);
+    minor1 = B::add(B::mul(row2, tmp), minor1);
+    minor2 = B::sub(minor2, B::mul(row1, tmp));
+
+    tmp = B::swapPairs(B::mul(row0, row2));
+    minor1 = B::add(B::mul(row3, tmp), minor1);
+    minor3 = B::sub(minor3, B::mul(row1, tmp));
+    tmp = B::swapHalves(tmp);
+    minor1 = B::sub(minor1, B::mul(row3, tmp));
+    minor3 = B::add(B::mul(row1, tmp), minor3);
+
+    float det = B::sum(B::mul(row0, minor0));
+    if (det == 0.0f || !std::isfinite(det))
+    {
+        return false;
+    }
+    V inv = B::splat(1.0f / det);
+    B::store(out, B::mul(minor0, inv));
+    B::store(out + 4, B::mul(minor1, inv));
+    B::store(out + 8, B::mul(minor2, inv));
+    B::store(out + 12, B::mul(minor3, inv));
+    return true;
+}
+
+template <typename B>
+inline void mat4MultiplySimd(const float *a, const float *b, float *out)
+{
+    typedef typename B::V V;
+    V a0 = B::load(a), a1 = B::load(a + 4), a2 = B::load(a + 8), a3 = B::load(a + 12);
+    for (int col = 0; col < 4; col++)
+    {
+        const float *bc = b + col * 4;
+        V r = B::mul(a0, B::splat(bc[0]));
+        r = B::add(r, B::mul(a1, B::splat(bc[1])));
+        r = B::add(r, B::mul(a2, B::splat(bc[2])));
+        r = B::add(r, B::mul(a3, B::splat(bc[3])));
+        B::store(out + col * 4, r);
+    }
+}
+
+template <typename B>
+inline void mat4TransformSimd(const float *m, const float *v, float *out)
+{
+    typedef typename B::V V;
+    V r = B::mul(B::load(m), B::splat(v[0]));
+    r = B::add(r, B::mul(B::load(m + 4), B::splat(v[1])));
+    r = B::add(r, B::mul(B::load(m + 8), B::splat(v[2])));
+    r = B::add(r, B::mul(B::load(m + 12), B::splat(v[3])));
+    B::store(out, r);
+}
+
+template <typename B>
+inline void mat4TransposeSimd(const float *m, float *out)
+{
+    typename B::V r0, r1, r2, r3;
+    B::transpose(m, r0, r1, r2, r3);
+    B::store(out, r0);
+    B::store(out + 4, r1);
+    B::store(out + 8, r2);
+    B::store(out + 12, r3);
+}
+
+template <typename B>
+inline bool mat4AffineInverseSimd(const float *m, float *out)
+{
+    typedef typename B::V V;
+    V c0 = B::load(m), c1 = B::load(m + 4), c2 = B::load(m + 8);
+    V r0 = B::cross(c1, c2);
+    float det = B::sum3(B::mul(c0, r0));
+    if (det == 0.0f || !std::isfinite(det))
+    {
+        return false;
+    }
+    V inv = B::splat(1.0f / det);
+    r0 = B::mul(r0, inv);
+    V r1 = B::mul(B::cross(c2, c0), inv);
+    V r2 = B::mul(B::cross(c0, c1), inv);
+    V r3 = B::splat(0.0f);
+    // Rows back into columns; w of each is 0 since the crosses' w is
+    B::transpose4(r0, r1, r2, r3);
+    V t = B::mul(r0, B::splat(m[12]));
+    t = B::add(t, B::mul(r1, B::splat(m[13])));
+    t = B::add(t, B::mul(r2, B::splat(m[14])));
+    B::store(out, r0);
+    B::store(out + 4, r1);
+    B::store(out + 8, r2);
+    B::store(out + 12, B::sub(r3, t));
+    out[15] = 1.0f;
+    return true;
+}
+
+#ifdef MAT4_KERNELS_SSE2
+struct Mat4OpsSSE2
+{
+    typedef __m128 V;
+    static V load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    static V splat(float s) { return _mm_set1_ps(s); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V swapPairs(V v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)); }
+    static V swapHalves(V v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)); }
+    static float sum(V v)
+    {
+        v = _mm_add_ps(v, swapHalves(v));
+        return _mm_cvtss_f32(_mm_add_ss(v, swapPairs(v)));
+    }
+    static float sum3(V v)
+    {
+        V y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+        V z = _mm_movehl_ps(v, v);
+        return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(v, y), z));
+    }
+    static V cross(V a, V b)
+    {
+        V aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        V bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        V c = _mm_sub_ps(_mm_mul_ps(a, bYzx), _mm_mul_ps(aYzx, b));
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+    static void transpose4(V &r0, V &r1, V &r2, V &r3)
+    {
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    }
+    static void transpose(const float *m, V &r0, V &r1, V &r2, V &r3)
+    {
+        r0 = load(m);
+        r1 = load(m + 4);
+        r2 = load(m + 8);
+        r3 = load(m + 12);
+        transpose4(r0, r1, r2, r3);
+    }
+};
+
+inline void mat4MultiplySSE2(const float *a, const float *b, float *out) { mat4MultiplySimd<Mat4OpsSSE2>(a, b, out); }
+inline void mat4TransformSSE2(const float *m, const float *v, float *out) { mat4TransformSimd<Mat4OpsSSE2>(m, v, out); }
+inline void mat4TransposeSSE2(const float *m, float *out) { mat4TransposeSimd<Mat4OpsSSE2>(m, out); }
+inline bool mat4InverseSSE2(const float *m, float *out) { return mat4InverseSimd<Mat4OpsSSE2>(m, out); }
+inline bool mat4AffineInverseSSE2(const float *m, float *out) { return mat4AffineInverseSimd<Mat4OpsSSE2>(m, out); }
+#endif
+
+#ifdef MAT4_KERNELS_AVX2
+// Two result columns per 256-bit register; the other kernels gain
+// nothing from the extra width and share the SSE2 ones
+__attribute__((target("avx2"))) inline void mat4MultiplyAVX2(const float *a, const float *b, float *out)
+{
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 12));
+    for (int col = 0; col < 4; col += 2)
+    {
+        __m256 bc = _mm256_loadu_ps(b + col * 4);
+        __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(bc, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(bc, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(bc, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(bc, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm256_storeu_ps(out + col * 4, r);
+    }
+}
+
+inline bool cpuHasAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#ifdef MAT4_KERNELS_NEON
+struct Mat4OpsNEON
+{
+    typedef float32x4_t V;
+    static V load(const float *p) { return vld1q_f32(p); }
+    static void store(float *p, V v) { vst1q_f32(p, v); }
+    static V splat(float s) { return vdupq_n_f32(s); }
+    static V add(V a, V b) { return vaddq_f32(a, b); }
+    static V sub(V a, V b) { return vsubq_f32(a, b); }
+    static V mul(V a, V b) { return vmulq_f32(a, b); }
+    static V swapPairs(V v) { return vrev64q_f32(v); }
+    static V swapHalves(V v) { return vextq_f32(v, v, 2); }
+    static float sum(V v)
+    {
+        float32x2_t h = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpadd_f32(h, h), 0);
+    }
+    static float sum3(V v)
+    {
+        return vgetq_lane_f32(v, 0) + vgetq_lane_f32(v, 1) + vgetq_lane_f32(v, 2);
+    }
+    static V yzx(V v)
+    {
+        // (y, z, w, x) with the top two lanes swapped back
+        float32x4_t e = vextq_f32(v, v, 1);
+        return vcombine_f32(vget_low_f32(e), vrev64_f32(vget_high_f32(e)));
+    }
+    static V cross(V a, V b)
+    {
+        V c = vsubq_f32(vmulq_f32(a, yzx(b)), vmulq_f32(yzx(a), b));
+        return yzx(c);
+    }
+    static void transpose4(V &r0, V &r1, V &r2, V &r3)
+    {
+        float32x4x2_t t01 = vtrnq_f32(r0, r1);
+        float32x4x2_t t23 = vtrnq_f32(r2, r3);
+        r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+    static void transpose(const float *m, V &r0, V &r1, V &r2, V &r3)
+    {
+        float32x4x4_t t = vld4q_f32(m);
+        r0 = t.val[0];
+        r1 = t.val[1];
+        r2 = t.val[2];
+        r3 = t.val[3];
+    }
+};
+
+inline void mat4MultiplyNEON(const float *a, const float *b, float *out) { mat4MultiplySimd<Mat4OpsNEON>(a, b, out); }
+inline void mat4TransformNEON(const float *m, const float *v, float *out) { mat4TransformSimd<Mat4OpsNEON>(m, v, out); }
+inline void mat4TransposeNEON(const float *m, float *out) { mat4TransposeSimd<Mat4OpsNEON>(m, out); }
+inline bool mat4InverseNEON(const float *m, float *out) { return mat4InverseSimd<Mat4OpsNEON>(m, out); }
+inline bool mat4AffineInverseNEON(const float *m, float *out) { return mat4AffineInverseSimd<Mat4OpsNEON>(m, out); }
+#endif
+
+// Kernels for `level`, or nullptr when this build or CPU can't run them
+inline const Mat4Kernels *mat4KernelsFor(SimdLevel level)
+{
+    static const Mat4Kernels scalar = {SimdLevel::Scalar, mat4MultiplyScalar, mat4TransformScalar,
+                                       mat4TransposeScalar, mat4InverseScalar, mat4AffineInverseScalar};
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return &scalar;
+#ifdef MAT4_KERNELS_SSE2
+    case SimdLevel::SSE2:
+    {
+        static const Mat4Kernels sse2 = {SimdLevel::SSE2, mat4MultiplySSE2, mat4TransformSSE2,
+                                         mat4TransposeSSE2, mat4InverseSSE2, mat4AffineInverseSSE2};
+        return &sse2;
+    }
+#endif
+#ifdef MAT4_KERNELS_AVX2
+    case SimdLevel::AVX2:
+    {
+        static const Mat4Kernels avx2 = {SimdLevel::AVX2, mat4MultiplyAVX2, mat4TransformSSE2,
+                                         mat4TransposeSSE2, mat4InverseSSE2, mat4AffineInverseSSE2};
+        return cpuHasAVX2() ? &avx2 : nullptr;
+    }
+#endif
+#ifdef MAT4_KERNELS_NEON
+    case SimdLevel::NEON:
+    {
+        static const Mat4Kernels neon = {SimdLevel::NEON, mat4MultiplyNEON, mat4TransformNEON,
+                                         mat4TransposeNEON, mat4InverseNEON, mat4AffineInverseNEON};
+        return &neon;
+    }
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+inline SimdLevel bestSimdLevel()
+{
+    const SimdLevel order[] = {SimdLevel::AVX2, SimdLevel::NEON, SimdLevel::SSE2};
+    for (SimdLevel level : order)
+    {
+        if (mat4KernelsFor(level) != nullptr)
+        {
+            return level;
+        }
+    }
+    return SimdLevel::Scalar;
+}
+
+inline const Mat4Kernels *&activeMat4Kernels()
+{
+    static const Mat4Kernels *kernels = mat4KernelsFor(bestSimdLevel());
+    return kernels;
+}
+
+// The kernels Mat4 uses
+inline const Mat4Kernels &mat4Kernels()
+{
+    return *activeMat4Kernels();
+}
+
+// Switches Mat4 to another instruction set, e.g. Scalar to check results
+// against; returns false (and changes nothing) when it isn't available
+inline bool setMat4Kernels(SimdLevel level)
+{
+    const Mat4Kernels *kernels = mat4KernelsFor(level);
+    if (kernels == nullptr)
+    {
+        return false;
+    }
+    activeMat4Kernels() = kernels;
+    return true;
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef MESH_MERGE_H
+#define MESH_MERGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include "vector.h"
+#include "bounds.h"
+
+// One mesh to bake into a merged mesh: its vertices are transformed by
+// `model` and colored `color` times the per-vertex color (if any)
+struct MeshPart
+{
+    const Vector3 *vertices = nullptr;
+    size_t vertexCount = 0;
+    const Vector4 *vertexColors = nullptr; // nullptr: every vertex white
+    const unsigned int *indices = nullptr;
+    size_t indexCount = 0; // 0: the part is drawn as 0, 1, ..., vertexCount - 1
+    Mat4 model;
+    Vector4 color = Vector4::one();
+};
+
+// Always indexed, with one color per vertex
+struct MergedMesh
+{
+    std::vector<Vector3> vertices;
+    std::vector<Vector4> colors;
+    std::vector<unsigned int> indices;
+    AABB bounds;
+};
+
+// Writes part `p` at the given offsets into `out`, returning its bounds
+inline AABB mergePart(const MeshPart &p, size_t vertexOffset, size_t indexOffset, MergedMesh &out)
+{
+    AABB bounds;
+    Vector3 *v = out.vertices.data() + vertexOffset;
+    Vector4 *c = out.colors.data() + vertexOffset;
+    bool affine2D = p.model.isAffine2D(); // the usual case: only xy moves, 4 multiplies a vertex instead of 9
+    Mat3x2 model2D = Mat3x2::fromMat4(p.model);
+    for (size_t i = 0; i < p.vertexCount; i++)
+    {
+        if (affine2D)
+        {
+            Vector2 xy = model2D.transformPoint(Vector2(p.vertices[i].x, p.vertices[i].y));
+            v[i] = Vector3(xy.x, xy.y, p.vertices[i].z);
+        }
+        else
+        {
+            v[i] = p.model.transformPoint(p.vertices[i]);
+        }
+        bounds.expand(v[i]);
+        if (p.vertexColors != nullptr)
+        {
+            const Vector4 &vc = p.vertexColors[i];
+            c[i] = Vector4(p.color.x * vc.x, p.color.y * vc.y, p.color.z * vc.z, p.color.w * vc.w);
+        }
+        else
+        {
+            c[i] = p.color;
+        }
+    }
+    unsigned int base = (unsigned int)vertexOffset;
+    unsigned int *idx = out.indices.data() + indexOffset;
+    if (p.indexCount > 0)
+    {
+        for (size_t i = 0; i < p.indexCount; i++)
+        {
+            idx[i] = base + p.indices[i];
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < p.vertexCount; i++)
+        {
+            idx[i] = base + (unsigned int)i;
+        }
+    }
+    return bounds;
+}
+
+// Bakes `parts` into one mesh, in order. Output offsets come from a prefix
+// sum up front, so once the merge has more than `parallelVertices`
+// vertices the parts are split into contiguous runs of roughly equal
+// vertex count and written by several threads without any locking.
+inline void mergeMeshes(const std::vector<MeshPart> &parts, MergedMesh &out, size_t parallelVertices = 65536)
+{
+    std::vector<size_t> vertexOffsets(parts.size() + 1, 0);
+    std::vector<size_t> indexOffsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+        const MeshPart &p = parts[i];
+        vertexOffsets[i + 1] = vertexOffsets[i] + p.vertexCount;
+        indexOffsets[i + 1] = indexOffsets[i] + (p.indexCount > 0 ? p.indexCount : p.vertexCount);
+    }
+    size_t totalVertices = vertexOffsets.back();
+    out.vertices.resize(totalVertices);
+    out.colors.resize(totalVertices);
+    out.indices.resize(indexOffsets.back());
+    out.bounds = AABB();
+
+    size_t threads = 1;
+    if (totalVertices > parallelVertices)
+    {
+        threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), parts.size());
+        threads = std::min(threads, totalVertices / (parallelVertices / 4) + 1);
+    }
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            out.bounds.merge(mergePart(parts[i], vertexOffsets[i], indexOffsets[i], out));
+        }
+        return;
+    }
+
+    // Part boundaries at every 1/threads of the vertices
+    std::vector<size_t> firstPart(threads + 1, parts.size());
+    firstPart[0] = 0;
+    for (size_t t = 1; t < threads; t++)
+    {
+        size_t target = totalVertices * t / threads;
+        firstPart[t] = std::upper_bound(vertexOffsets.begin(), vertexOffsets.end() - 1, target) - vertexOffsets.begin() - 1;
+        firstPart[t] = std::max(firstPart[t], firstPart[t - 1]);
+    }
+
+    std::vector<AABB> bounds(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    auto run = [&](size_t t)
+    {
+        for (size_t i = firstPart[t]; i < firstPart[t + 1]; i++)
+        {
+            bounds[t].merge(mergePart(parts[i], vertexOffsets[i], indexOffsets[i], out));
+        }
+    };
+    for (size_t t = 1; t < threads; t++)
+    {
+        workers.emplace_back(run, t);
+    }
+    run(0);
+    for (std::thread &w : workers)
+    {
+        w.join();
+    }
+    for (const AABB &b : bounds)
+    {
+        out.bounds.merge(b);
+    }
+}
+
+#endif
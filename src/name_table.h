@@ -0,0 +1,114 @@
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef uint32_t NameId;
+static const NameId invalidName = 0xFFFFFFFFu;
+
+// Interns strings into small, stable ids. Lookups go through a flat
+// open-addressing table (linear probing, load <= 1/2) keyed by
+// string_view, so finding an existing name never allocates.
+class NameTable
+{
+private:
+    struct Bucket
+    {
+        uint32_t hash;
+        NameId id; // invalidName when empty
+    };
+
+    std::deque<std::string> names; // indexed by NameId, element addresses never move
+    std::vector<Bucket> buckets;
+
+    static uint32_t hashOf(std::string_view s)
+    {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (char c : s)
+        {
+            h ^= (unsigned char)c;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    size_t findBucket(std::string_view s, uint32_t hash) const
+    {
+        size_t mask = buckets.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            const Bucket &b = buckets[i];
+            if (b.id == invalidName || (b.hash == hash && names[b.id] == s))
+            {
+                return i;
+            }
+        }
+    }
+
+    void grow()
+    {
+        std::vector<Bucket> old;
+        old.swap(buckets);
+        buckets.assign(old.empty() ? 16 : old.size() * 2, Bucket{0, invalidName});
+
+        size_t mask = buckets.size() - 1;
+        for (const Bucket &b : old)
+        {
+            if (b.id == invalidName)
+            {
+                continue;
+            }
+            size_t i = b.hash & mask;
+            while (buckets[i].id != invalidName)
+            {
+                i = (i + 1) & mask;
+            }
+            buckets[i] = b;
+        }
+    }
+
+public:
+    // Returns the id for `s`, adding it on first sight
+    NameId intern(std::string_view s)
+    {
+        if ((names.size() + 1) * 2 > buckets.size())
+        {
+            grow();
+        }
+        uint32_t hash = hashOf(s);
+        Bucket &b = buckets[findBucket(s, hash)];
+        if (b.id == invalidName)
+        {
+            b.hash = hash;
+            b.id = (NameId)names.size();
+            names.emplace_back(s);
+        }
+        return b.id;
+    }
+
+    // Returns the id for `s`, or invalidName if it was never interned
+    NameId find(std::string_view s) const
+    {
+        if (buckets.empty())
+        {
+            return invalidName;
+        }
+        return buckets[findBucket(s, hashOf(s))].id;
+    }
+
+    std::string_view name(NameId id) const
+    {
+        return id < names.size() ? std::string_view(names[id]) : std::string_view();
+    }
+
+    size_t size() const
+    {
+        return names.size();
+    }
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "vector.h"
+
+// Sort key fields, most significant first. Sorting by the key groups
+// draws so that consecutive items share as much GL state as possible;
+// the layer comes first so callers keep explicit control over overlap.
+//
+//     63      56 55        44 43        32 31          16 15           0
+//     [ layer  ][  program   ][    mesh    ][  material    ][   depth     ]
+inline uint64_t makeSortKey(int layer, uint32_t program, uint32_t mesh, uint32_t material, uint32_t depth)
+{
+    uint64_t l = (uint64_t)(uint8_t)(std::min(std::max(layer, -128), 127) + 128);
+    return (l << 56) |
+           ((uint64_t)(program & 0xFFF) << 44) |
+           ((uint64_t)(mesh & 0xFFF) << 32) |
+           ((uint64_t)(material & 0xFFFF) << 16) |
+           (uint64_t)(depth & 0xFFFF);
+}
+
+// 16-bit fold of the RGBA8 color, so equal colors sort together
+inline uint32_t sortKeyMaterial(const Vector4 &c)
+{
+    auto channel = [](float v)
+    { return (uint32_t)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); };
+    uint32_t rgba = channel(c.x) << 24 | channel(c.y) << 16 | channel(c.z) << 8 | channel(c.w);
+    return (rgba >> 16) ^ (rgba & 0xFFFF);
+}
+
+// z in [-range, range] to 16 bits, lower z first
+inline uint32_t sortKeyDepth(float z, float range)
+{
+    float t = range > 0.0f ? std::min(std::max(z / range, -1.0f), 1.0f) : 0.0f;
+    return (uint32_t)((t * 0.5f + 0.5f) * 65535.0f);
+}
+
+// Per-frame list of draw items ordered by 64-bit sort key. Items carry an
+// opaque index back into the caller's data. sort() is an LSD radix sort
+// over the key bytes (stable, so equal keys keep insertion order); bytes
+// that every key shares are skipped, which in practice leaves two or
+// three passes.
+class RenderQueue
+{
+public:
+    struct Item
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+private:
+    std::vector<Item> items;
+    std::vector<Item> scratch;
+
+public:
+    void clear()
+    {
+        items.clear();
+    }
+
+    void add(uint64_t key, uint32_t index)
+    {
+        items.push_back({key, index});
+    }
+
+    void sort()
+    {
+        scratch.resize(items.size());
+        for (int shift = 0; shift < 64 && items.size() > 1; shift += 8)
+        {
+            size_t counts[256] = {};
+            for (const Item &item : items)
+            {
+                counts[(item.key >> shift) & 0xFF]++;
+            }
+            if (counts[(items[0].key >> shift) & 0xFF] == items.size())
+            {
+                continue; // every key has the same byte here
+            }
+            size_t offset = 0;
+            for (size_t &count : counts)
+            {
+                size_t n = count;
+                count = offset;
+                offset += n;
+            }
+            for (const Item &item : items)
+            {
+                scratch[counts[(item.key >> shift) & 0xFF]++] = item;
+            }
+            items.swap(scratch);
+        }
+    }
+
+    const std::vector<Item> &getItems() const
+    {
+        return items;
+    }
+
+    size_t size() const
+    {
+        return items.size();
+    }
+};
+
+#endif
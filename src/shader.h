@@ -0,0 +1,201 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <iostream>
+#include <glad/glad.h>
+#include <string>
+#include <unordered_map>
+#include "vector.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+// Uniform block shared by every program; holds the constants that change
+// once per frame rather than once per shape.
+//
+//     layout (std140) uniform Frame { mat4 uViewProj; };
+class FrameUniforms
+{
+private:
+    GpuBuffer buffer = GpuBuffer(GL_UNIFORM_BUFFER);
+
+public:
+    static constexpr GLuint bindingPoint = 0;
+
+    void update(const Mat4 &viewProj)
+    {
+        buffer.reserve(sizeof(viewProj.m), GL_DYNAMIC_DRAW);
+        buffer.update(0, sizeof(viewProj.m), viewProj.m);
+        GLState::getInstance().bindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer.id());
+    }
+};
+
+// Linked GL program with its uniform locations resolved once at link time
+class ShaderProgram
+{
+private:
+    GLuint program = 0;
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    // The program declares its model transform (uModel, aInstanceModel or
+    // the indirect draws[].model) as mat3x2 rather than mat4; shapes then
+    // send a Mat3x2 and skip the 4x4 work. Meant for World::set2DMode.
+    bool model2D = false;
+
+    static GLuint compile(GLenum type, const char *src)
+    {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &src, nullptr);
+        glCompileShader(shader);
+
+        GLint ok = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok)
+        {
+            char log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            std::cerr << "Failed to compile shader: " << log << std::endl;
+        }
+        return shader;
+    }
+
+    void resolveUniforms()
+    {
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            char name[256];
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, i, sizeof(name), &length, &size, &type, name);
+            GLint location = glGetUniformLocation(program, name);
+            if (location >= 0) // members of uniform blocks have no location
+            {
+                uniformLocations[std::string(name, length)] = location;
+            }
+            if (std::string(name, length) == "uModel")
+            {
+                model2D = type == GL_FLOAT_MAT3x2;
+            }
+        }
+        if (GLAD_GL_VERSION_4_3)
+        {
+            // Indirect programs take the model from their per-draw data instead
+            GLuint member = glGetProgramResourceIndex(program, GL_BUFFER_VARIABLE, "draws[0].model");
+            if (member != GL_INVALID_INDEX)
+            {
+                GLenum property = GL_TYPE;
+                GLint type = 0;
+                glGetProgramResourceiv(program, GL_BUFFER_VARIABLE, member, 1, &property, 1, nullptr, &type);
+                model2D = type == GL_FLOAT_MAT3x2;
+            }
+        }
+
+        GLuint frameBlock = glGetUniformBlockIndex(program, "Frame");
+        if (frameBlock != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(program, frameBlock, FrameUniforms::bindingPoint);
+        }
+
+        uModel = uniform("uModel");
+        uColor = uniform("uColor");
+    }
+
+public:
+    // Vertex attribute locations shared by every program
+    static constexpr GLuint positionAttribute = 0;
+    static constexpr GLuint colorAttribute = 1;
+    static constexpr GLuint instanceModelAttribute = 2; // mat4 at locations 2-5, or mat3x2 at 2-4
+    static constexpr GLuint instanceColorAttribute = 6;
+    static constexpr GLuint drawIdAttribute = 7; // per-draw data slot for indirect draws
+
+    // Locations every shape sets, -1 when the program doesn't use them
+    GLint uModel = -1;
+    GLint uColor = -1;
+
+    ShaderProgram(const char *vertexSrc, const char *fragmentSrc)
+    {
+        GLuint vert = compile(GL_VERTEX_SHADER, vertexSrc);
+        GLuint frag = compile(GL_FRAGMENT_SHADER, fragmentSrc);
+
+        program = glCreateProgram();
+        glAttachShader(program, vert);
+        glAttachShader(program, frag);
+        glLinkProgram(program);
+
+        glDeleteShader(vert);
+        glDeleteShader(frag);
+
+        GLint ok = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (!ok)
+        {
+            char log[1024];
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            std::cerr << "Failed to link shader program: " << log << std::endl;
+            return;
+        }
+
+        resolveUniforms();
+
+        // Read by shapes whose vertex array doesn't feed these from a buffer
+        GLState &state = GLState::getInstance();
+        state.setAttributeDefault(colorAttribute, 1.0f, 1.0f, 1.0f, 1.0f);
+        for (GLuint col = 0; col < 4; col++)
+        {
+            state.setAttributeDefault(instanceModelAttribute + col, col == 0, col == 1, col == 2, col == 3); // identity
+        }
+        state.setAttributeDefault(instanceColorAttribute, 1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    ~ShaderProgram()
+    {
+        glDeleteProgram(program);
+        GLState::getInstance().deletedProgram(program);
+    }
+
+    ShaderProgram(const ShaderProgram &) = delete;
+    ShaderProgram &operator=(const ShaderProgram &) = delete;
+
+    GLint uniform(const std::string &name) const
+    {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+
+    // Does nothing when the program is already current
+    void use() const
+    {
+        GLState::getInstance().useProgram(program);
+    }
+
+    GLuint id() const
+    {
+        return program;
+    }
+
+    // Per-shape uniforms; the program must be current. Unchanged values
+    // are not re-sent (see GLState).
+    void setColor(const Vector4 &c) const
+    {
+        GLState::getInstance().uniform4f(uColor, c.x, c.y, c.z, c.w);
+    }
+
+    void setModel(const Mat4 &model) const
+    {
+        GLState::getInstance().uniformMatrix4(uModel, model.m); // view/projection come from the Frame block
+    }
+
+    void setModel(const Mat3x2 &model) const
+    {
+        GLState::getInstance().uniformMatrix3x2(uModel, model.m);
+    }
+
+    bool takesModel2D() const
+    {
+        return model2D;
+    }
+};
+
+#endif
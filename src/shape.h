@@ -6,22 +6,148 @@
 #include "vector.h"
 #include <vector>
 #include "functional_utils.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "shader.h"
+#include "slot_map.h"
+#include "name_table.h"
+#include "bounds.h"
+#include "spatial_hash.h"
+#include "aabb_tree.h"
+#include "geometry_pool.h"
+#include "indirect_draw.h"
+#include "stream_ring.h"
+#include "render_queue.h"
+#include "mesh_merge.h"
 #include <GLFW/glfw3.h>
 #include <unordered_map>
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
 
 class Shape;
 class CompoundShape;
+class InstancedShape;
+
+typedef SlotHandle ShapeHandle;
+typedef SlotHandle InstanceHandle;
+typedef std::pair<Shape *, Shape *> ShapePair;
+
+// What translate does when a move would push a shape into another one
+enum class CollisionResponse
+{
+    None,  // shapes pass through each other
+    Block, // the whole move is rejected
+    Clip   // the move is shortened per axis so the shape stops at contact
+};
 
 class World
 {
 private:
+    struct BoundShape
+    {
+        Shape *shape;
+        NameId name;
+    };
+
     Vector3 worldSize;
-    std::vector<Shape *> shapes;
-    std::unordered_map<std::string, Shape *> shapeNames;
+    SlotMap<BoundShape> shapes;
+    NameTable names;
+    std::vector<ShapeHandle> shapeNames; // indexed by NameId
+
+    // Broad phase, keyed by slot index. Shapes whose bounds changed are
+    // queued and re-bucketed in syncBounds() before anything reads the hash.
+    SpatialHash broadPhase;
+    std::vector<Shape *> slotShapes;
+    std::vector<ShapeHandle> boundsQueue;
+    CollisionResponse collisionResponse = CollisionResponse::None;
+    std::vector<ShapePair> overlappingPairs;
+    std::vector<std::pair<uint32_t, uint32_t>> pairScratch;
+    std::vector<uint32_t> collisionCandidates;
+
+    // Dynamic AABB tree over the same slot indices, for picking and
+    // spatial queries. Shapes without geometry have no leaf.
+    AABBTree shapeTree;
+    std::vector<int> treeLeaves;
+
+    // Culling input: shape bounds as separate lanes in the same dense
+    // order as `shapes`, so the visibility test streams through them
+    std::vector<float> cullMinX, cullMinY, cullMaxX, cullMaxY;
+    std::vector<uint32_t> visibleList; // dense indices drawn this frame
+    bool cullingEnabled = true;
+    bool mode2D = false;
+
+    // Multi-draw-indirect submission, active once a program is set
+    IndirectRenderer indirect;
+    const ShaderProgram *indirectReplaces = nullptr;
+    size_t lastDrawCalls = 0;
+    uint64_t frameIndex = 0; // counts drawAllShapes() calls
+    void drawIndirect();
+
+    // Visible shapes ordered by sort key, rebuilt every frame
+    RenderQueue renderQueue;
+    GLStateStats renderStats;
+    void queueVisibleShapes();
+    void drawQueued();
+    void drawItem(uint32_t item);
+    void queueIndirect(Shape *shape);
+
+    // Static shapes are not drawn one by one: they are baked, already
+    // transformed and colored, into one pooled mesh per spatial cell,
+    // program and layer. A batch is re-merged when a member joins, leaves
+    // or changes. Queue items for batches have staticItemBit set.
+    struct StaticBatch
+    {
+        std::tuple<int, int, GLuint, int> key; // cell x, cell y, program, layer
+        ShaderProgram *shader;
+        int layer;
+        std::vector<ShapeHandle> members;
+        Shape *mesh = nullptr; // owned; null while the batch is empty
+        AABB bounds;
+        bool dirty = true;
+    };
+    static constexpr uint32_t staticItemBit = 0x80000000u;
+    float staticCellSize = 64.0f;
+    std::vector<StaticBatch> staticBatches;
+    std::map<std::tuple<int, int, GLuint, int>, uint32_t> staticBatchLookup;
+    std::vector<MeshPart> mergeParts;
+    MergedMesh merged;
+    void addToStaticBatch(Shape *shape);
+    void removeFromStaticBatch(Shape *shape);
+    void rebuildStaticBatches();
+
+    void setCullBounds(uint32_t dense, const AABB &bounds)
+    {
+        cullMinX[dense] = bounds.min.x;
+        cullMinY[dense] = bounds.min.y;
+        cullMaxX[dense] = bounds.max.x;
+        cullMaxY[dense] = bounds.max.y;
+    }
+    void cullShapes();
+    void updateShapeUsage();
+
+    void clipAxis(const AABB &box, Vector3 &delta, int axis);
+    void updateTreeLeaf(uint32_t slot, const AABB &bounds);
+
+    Mat4 computeViewProjection() const
+    {
+        return Mat4::ortho(0.0f, worldSize.x, 0.0f, worldSize.y, -1.0f, 1.0f) * view;
+    }
+
+    // Per-frame constants, computed once in updateFrameConstants()
+    Mat4 view;
+    Mat4 viewProjection;
+    FrameUniforms frameUniforms;
 
 public:
-    World() {}
-    ~World() {}
+    World()
+    {
+        GpuResources::getInstance(); // constructed first so it outlives frameUniforms at exit
+        GeometryPool::getInstance(); // shapes still bound at exit free their ranges into it
+    }
+    ~World();
     void setWorldSize(const Vector3 &size)
     {
         worldSize = size;
@@ -30,384 +156,1765 @@ public:
     {
         return worldSize;
     }
-    void bindShape(std::string name, Shape *shape)
+    void setView(const Mat4 &v)
     {
-        shapes.push_back(shape);
-        shapeNames[name] = shape;
+        view = v;
+    }
+    const Mat4 &getViewProjection() const
+    {
+        return viewProjection;
     }
 
-    Shape *getShape(std::string name)
+    // Builds projection * view for this frame and publishes it to the
+    // Frame uniform block; shapes then only upload their own model/color
+    void updateFrameConstants()
     {
-        return shapeNames[name];
+        viewProjection = computeViewProjection();
+        frameUniforms.update(viewProjection);
     }
-    bool translateCallback(Shape *shape, const Vector3 &delta);
+    ShapeHandle bindShape(std::string_view name, Shape *shape);
+    bool unbindShape(ShapeHandle handle);
+    bool unbindShape(Shape *shape);
 
-    Vector2
-    getMousePos(GLFWwindow *window)
+    // Stable id for a shape name; resolve hot-path names once and look
+    // shapes up by id afterwards
+    NameId internName(std::string_view name)
     {
-        double xpos, ypos;
-        glfwGetCursorPos(window, &xpos, &ypos);
-        return Vector2(static_cast<float>(xpos), static_cast<float>(ypos));
+        NameId id = names.intern(name);
+        if (id >= shapeNames.size())
+        {
+            shapeNames.resize(id + 1);
+        }
+        return id;
     }
 
-    void drawAllShapes();
+    Shape *getShape(ShapeHandle handle) const
+    {
+        const BoundShape *bound = shapes.get(handle);
+        return bound ? bound->shape : nullptr;
+    }
 
-    static World &getInstance()
+    // Find-or-null lookups; neither allocates nor adds missing names
+    Shape *findShape(NameId name) const
     {
-        static World instance;
-        return instance;
+        return name < shapeNames.size() ? getShape(shapeNames[name]) : nullptr;
     }
 
-    static bool isBound(Shape *shape)
+    Shape *findShape(std::string_view name) const
     {
-        World &world = getInstance();
-        for (auto s : world.shapes)
-        {
-            if (s == shape)
-            {
-                return true;
-            }
-        }
-        return false;
+        return findShape(names.find(name));
     }
 
-    static bool isBound(std::string name)
+    Shape *getShape(std::string_view name) const
     {
-        World &world = getInstance();
-        return world.shapeNames.find(name) != world.shapeNames.end();
+        return findShape(name);
     }
-};
 
-class Shape
-{
-protected:
-    std::vector<Vector3> vertices;
+    size_t getShapeCount() const
+    {
+        return shapes.size();
+    }
 
-    unsigned int Vertex_Array_Object, Vertex_Buffer_Object;
-    Vector4 color;
-    GLuint shader;
-    GLFWwindow *window;
-    bool initialized = false;
+    // False once the shape behind the handle has been unbound
+    bool isValid(ShapeHandle handle) const
+    {
+        return shapes.contains(handle);
+    }
+    bool translateCallback(Shape *shape, Vector3 &delta);
+
+    void setCollisionResponse(CollisionResponse response)
+    {
+        collisionResponse = response;
+    }
+    CollisionResponse getCollisionResponse() const
+    {
+        return collisionResponse;
+    }
+    void setBroadPhaseCellSize(float size)
+    {
+        syncBounds();
+        broadPhase.setCellSize(size);
+    }
 
-    Mat4 model;
+    void queueBoundsUpdate(Shape *shape);
+    void syncBounds();
 
-    void init()
+    // Refreshes the broad phase and collects every pair of bound shapes
+    // whose boxes overlap; call once per frame
+    void updateCollisions();
+    const std::vector<ShapePair> &getOverlappingPairs() const
     {
-        glGenVertexArrays(1, &Vertex_Array_Object); // Create VAO
-        glGenBuffers(1, &Vertex_Buffer_Object);     // Create VBO
+        return overlappingPairs;
+    }
 
-        glBindVertexArray(Vertex_Array_Object); // register VAO as current
+    Vector2
+    getMousePos(GLFWwindow *window)
+    {
+        double xpos, ypos;
+        glfwGetCursorPos(window, &xpos, &ypos);
+        return Vector2(static_cast<float>(xpos), static_cast<float>(ypos));
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, Vertex_Buffer_Object);                                               // register VBO as current
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vector3), vertices.data(), GL_STATIC_DRAW); // fill buffer with vertex data
+    // Maps window coordinates (origin top-left) onto the z = 0 world plane
+    Vector2 screenToWorld(GLFWwindow *window, const Vector2 &screen) const;
 
-        glVertexAttribPointer(0 /*the shader location*/,
-                              3 /*Vertex size*/,
-                              GL_FLOAT /*data type*/,
-                              GL_FALSE /*Tell glad not to normalize the vectors*/,
-                              sizeof(Vector3) /*Distance between bytes */,
-                              (void *)0 /*Byte offset */); // GPU configuration for vertex drawing
+    // Spatial queries against shape bounds. Results go into the caller's
+    // buffers; each returns how many entries were written.
+    size_t queryPoint(const Vector2 &p, Shape **out, size_t capacity);
+    size_t queryRect(const AABB &rect, Shape **out, size_t capacity);
+    size_t raycast(const Vector2 &origin, const Vector2 &dir, float maxDistance,
+                   Shape **out, float *distances, size_t capacity);
+    size_t nearestShapes(const Vector2 &p, size_t k, Shape **out, float *distancesSq);
 
-        glEnableVertexAttribArray(0); // enable shader location 0
+    // Shape under the cursor, the one with the smallest box when several
+    // overlap; nullptr when there is none
+    Shape *pickShape(GLFWwindow *window);
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0); // clear VBO context
-        glBindVertexArray(0);             // clear VAO context
-    }
+    void drawAllShapes();
 
-public:
-    Shape(GLFWwindow *window, GLuint shader)
+    // World-space rectangle covered by the current projection * view
+    AABB getViewBounds() const;
+
+    void setCullingEnabled(bool enabled)
     {
-        this->window = window;
-        this->shader = shader;
-        model.loadIdentity();
+        cullingEnabled = enabled;
     }
-    ~Shape() {}
-    void addVertex(const Vector3 &v1)
+    bool isCullingEnabled() const
     {
-        vertices.push_back(v1);
-        initialized = false;
+        return cullingEnabled;
     }
-    void setVertex(int index, const Vector3 &v)
+    // Shapes lying in the z = 0 plane upload vec2 positions (a third less
+    // vertex memory); the rest keep the 3D layouts. Programs must accept
+    // either, e.g. a vec2 aPos, or a vec3 aPos that reads z as 0.
+    void set2DMode(bool on)
     {
-        if (index >= 0 && index < vertices.size())
-        {
-            vertices[index] = v;
-        }
-        else
+        mode2D = on;
+    }
+    bool is2DMode() const
+    {
+        return mode2D;
+    }
+    // Draws pooled shapes that use `replaces` through glMultiDraw*Indirect
+    // with `program` (see IndirectRenderer for what it must read). Returns
+    // false and keeps per-shape draws when the context is older than 4.3.
+    bool setMultiDrawProgram(ShaderProgram *program, const ShaderProgram *replaces)
+    {
+        if (program == nullptr || !IndirectRenderer::supported())
         {
-            vertices.push_back(v);
+            disableMultiDraw();
+            return false;
         }
-        initialized = false;
+        indirect.setProgram(program, replaces);
+        indirectReplaces = replaces;
+        return true;
     }
-
-    void clearVertices()
+    void disableMultiDraw()
     {
-        vertices.clear();
-        initialized = false;
+        indirect.setProgram(nullptr, nullptr);
+        indirect.release();
+        indirectReplaces = nullptr;
     }
-
-    void setColor(const Vector4 &c)
+    bool isMultiDrawEnabled() const
     {
-        color = c;
-        initialized = false;
+        return indirect.getProgram() != nullptr;
     }
-
-    void triangle_of(float a, float b, float c)
+    uint64_t getFrameIndex() const
     {
-        clearVertices();
-
-        Vector3 A(0, 0, 0);
-        Vector3 B(c, 0, 0);
-
-        float x = (b * b + c * c - a * a) / (2 * c);
-        float y = sqrt(b * b - x * x);
+        return frameIndex;
+    }
+    // Draw calls issued by the last drawAllShapes()
+    size_t getDrawCallCount() const
+    {
+        return lastDrawCalls;
+    }
 
-        Vector3 C(x, y, 0);
+    // GL calls issued and elided by the last drawAllShapes()
+    const GLStateStats &getRenderStats() const
+    {
+        return renderStats;
+    }
 
-        addVertex(A);
-        addVertex(B);
-        addVertex(C);
-        initialized = false;
+    // Static shapes are drawn from merged batches (see StaticBatch) and
+    // must not move often: any change re-merges their whole batch.
+    // Returns false for unbound shapes and ones that can't be merged.
+    bool setStatic(Shape *shape, bool isStatic);
+    bool setStatic(std::string_view name, bool isStatic)
+    {
+        Shape *shape = findShape(name);
+        return shape != nullptr && setStatic(shape, isStatic);
+    }
+    // Width of the square cells static shapes are grouped by; batches in
+    // cells outside the view are culled as a whole
+    void setStaticCellSize(float size);
+    void staticShapeChanged(Shape *shape); // called by static shapes when they change
+    size_t getStaticBatchCount() const
+    {
+        size_t count = 0;
+        for (const StaticBatch &batch : staticBatches)
+        {
+            count += batch.mesh != nullptr;
+        }
+        return count;
     }
 
-    void square(float size)
+    // Number of shapes that passed culling in the last drawAllShapes()
+    size_t getVisibleCount() const
     {
-        clearVertices();
+        return visibleList.size();
+    }
 
-        Vector3 A(0, 0, 0);
-        Vector3 B(size, 0, 0);
-        Vector3 C(size, size, 0);
-        Vector3 D(0, size, 0);
+    static World &getInstance()
+    {
+        static World instance;
+        return instance;
+    }
 
-        addVertex(A);
-        addVertex(B);
-        addVertex(C);
+    static bool isBound(Shape *shape);
 
-        addVertex(A);
-        addVertex(C);
-        addVertex(D);
-        initialized = false;
+    static bool isBound(std::string_view name)
+    {
+        return getInstance().findShape(name) != nullptr;
     }
+};
 
-    void rectangle(float width, float height)
-    {
-        clearVertices();
+class Shape
+{
+    friend class World;
 
-        Vector3 A(0, 0, 0);
-        Vector3 B(width, 0, 0);
-        Vector3 C(width, height, 0);
-        Vector3 D(0, height, 0);
+protected:
+    std::vector<Vector3> vertices;
+    std::vector<unsigned int> indices; // triangle list into vertices; empty means draw vertices in order
+
+    // Optional per-vertex colors, multiplied with `color` in the shader.
+    // Empty means the vertices upload as bare positions; otherwise they are
+    // interleaved as ColorVertex (or ColorVertex2D) with the color packed to RGBA8.
+    std::vector<Vector4> vertexColors;
+    VertexFormat uploadedFormat = VertexFormat::Position; // layout the GPU copy is in
+    size_t raisedVertices = 0;                            // vertices with z != 0, which rule out the 2D layouts
+
+    // Geometry normally lives in ranges of the shared GeometryPool. Stream
+    // shapes (re-sent every frame) and subclasses that need their own VAO
+    // keep private buffers instead.
+    bool pooled = true;
+    GeometryHandle poolVertices;
+    GeometryHandle poolIndices;
+    VertexArray vertexArray;
+    GpuBuffer vertexBuffer;
+    GpuBuffer indexBuffer = GpuBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    bool indicesDirty = false;
+    Vector4 color;
+    int layer = 0; // draw order bucket, lower first; clamped to [-128, 127]
+    ShaderProgram *shader;
+    GLFWwindow *window;
+    ShapeHandle handle; // set while bound to the World
+    bool boundsQueued = false;
+    int staticBatch = -1; // World::StaticBatch holding this shape, if static
 
-        addVertex(A);
-        addVertex(B);
-        addVertex(C);
+    // Vertex index ranges [begin, end) edited since the last upload. Kept
+    // sorted and coalesced; too many ranges collapse into their union.
+    struct VertexRange
+    {
+        size_t begin;
+        size_t end;
+    };
+    static constexpr size_t maxDirtyRanges = 8;
+    std::vector<VertexRange> dirtyRanges;
+
+    // Storage class. Unless pinned with setUsage() it follows how often the
+    // geometry is uploaded: bit i of uploadHistory is set when an upload
+    // happened i frames before historyFrame. Static and Dynamic shapes
+    // live in the GeometryPool (Dynamic ones patch their ranges often);
+    // Stream shapes are written into the StreamRing each frame, or into a
+    // private buffer orphaned on every upload when the ring is off.
+    BufferUsage usage = BufferUsage::Static;
+    bool usagePinned = false;
+    uint32_t uploadHistory = 0;
+    uint64_t historyFrame = 0;
+    bool storageMoved = false; // next upload only migrates, don't count it
+
+    // Where this frame's copy went when streamed through the StreamRing
+    uint64_t ringFrame = 0; // StreamRing frame of the copy, 0 for none
+    size_t ringVertexOffset = 0;
+    size_t ringIndexOffset = 0;
+    static constexpr int dynamicPromoteUploads = 4; // of the last 32 frames
+    static constexpr int streamPromoteUploads = 24;
+    static constexpr int streamDemoteUploads = 12;
+
+    void advanceHistory(uint64_t frame)
+    {
+        uint64_t elapsed = frame - historyFrame;
+        uploadHistory = elapsed >= 32 ? 0 : uploadHistory << elapsed;
+        historyFrame = frame;
+    }
 
-        addVertex(A);
-        addVertex(C);
-        addVertex(D);
-        initialized = false;
+    void recordUpload()
+    {
+        advanceHistory(World::getInstance().getFrameIndex());
+        uploadHistory |= 1;
     }
 
-    void regularPolygon(int sides, float radius)
+    // Moves the shape to the storage class its recent uploads call for.
+    // Promotion needs more uploads than demotion so shapes near a
+    // threshold don't flip every frame.
+    void updateUsage()
     {
-        clearVertices();
-        if (sides < 3)
+        if (usagePinned)
+        {
             return;
-
-        float angleStep = 2.0f * 3.14159265359f / sides;
-
-        Vector3 center(0, 0, 0);
-
-        for (int i = 0; i < sides; i++)
+        }
+        advanceHistory(World::getInstance().getFrameIndex());
+        int uploads = getRecentUploads();
+        BufferUsage next = usage;
+        if (uploads >= streamPromoteUploads)
         {
-            float angle1 = i * angleStep;
-            float angle2 = ((i + 1) % sides) * angleStep;
-
-            Vector3 vertex1(radius * cos(angle1), radius * sin(angle1), 0);
-            Vector3 vertex2(radius * cos(angle2), radius * sin(angle2), 0);
-
-            addVertex(center);
-            addVertex(vertex1);
-            addVertex(vertex2);
+            next = BufferUsage::Stream;
+        }
+        else if (uploads >= dynamicPromoteUploads)
+        {
+            next = usage == BufferUsage::Stream && uploads >= streamDemoteUploads ? BufferUsage::Stream : BufferUsage::Dynamic;
         }
-        initialized = false;
+        else if (uploads == 0)
+        {
+            next = BufferUsage::Static;
+        }
+        else if (usage == BufferUsage::Stream)
+        {
+            next = BufferUsage::Dynamic;
+        }
+        changeUsage(next);
     }
 
-    void translate(const Vector3 &p)
+    void changeUsage(BufferUsage next)
     {
-        World &world = World::getInstance();
-        if (!world.translateCallback(this, p))
-        {
-            return;
-        }
-        for (auto &v : vertices)
+        bool wasPooled = usesPool();
+        usage = next;
+        if (usesPool() != wasPooled)
         {
-            v = v + p;
+            indicesDirty = true; // the new storage starts empty
+            storageMoved = true;
         }
-        initialized = false;
     }
 
-    void setPos(const Vector3 &p)
+    void markDirty(size_t begin, size_t end)
     {
-        Vector3 v1 = vertices.at(0);
-        std::vector<Vector3> offsets;
-        for (const auto &v : vertices)
+        dirtyRanges.push_back({begin, end});
+        std::sort(dirtyRanges.begin(), dirtyRanges.end(),
+                  [](const VertexRange &a, const VertexRange &b)
+                  { return a.begin < b.begin; });
+
+        size_t merged = 0;
+        for (size_t i = 1; i < dirtyRanges.size(); i++)
         {
-            offsets.push_back(v - v1);
+            if (dirtyRanges[i].begin <= dirtyRanges[merged].end)
+            {
+                dirtyRanges[merged].end = std::max(dirtyRanges[merged].end, dirtyRanges[i].end);
+            }
+            else
+            {
+                dirtyRanges[++merged] = dirtyRanges[i];
+            }
         }
-        clearVertices();
-        for (const auto &offset : offsets)
+        dirtyRanges.resize(merged + 1);
+
+        if (dirtyRanges.size() > maxDirtyRanges)
         {
-            addVertex(p + offset);
+            VertexRange all = {dirtyRanges.front().begin, dirtyRanges.back().end};
+            dirtyRanges.assign(1, all);
         }
-        initialized = false;
     }
 
-    void setScale(float s)
+    // Local -> world transform. Vertices stay in local space and are only
+    // uploaded when the geometry itself changes; moving the shape just marks
+    // the model matrix dirty.
+    Vector3 position;
+    float rotation = 0.0f; // radians about z
+    Vector3 scale = Vector3::one();
+    mutable Mat4 model;
+    mutable bool modelDirty = false;
+    mutable Mat3x2 model2D; // the same transform for programs that take a mat3x2, see getModel2D()
+    mutable bool model2DDirty = false;
+
+    // Local bounds grow with every added vertex and are only rebuilt when
+    // an edit may have shrunk them; world bounds follow the transform
+    mutable AABB localBounds;
+    mutable bool localBoundsDirty = false;
+    mutable AABB worldBounds;
+    mutable bool worldBoundsDirty = false;
+
+    // World bounds moved; let the World re-bucket the shape
+    void boundsChanged()
     {
-        for (auto &v : vertices)
+        if (!boundsQueued && World::isBound(this))
         {
-            v = v * s;
+            World::getInstance().queueBoundsUpdate(this);
         }
-        initialized = false;
     }
 
-    std::vector<Vector3> getVertices() const
+    // Something a static batch baked in changed (color, indices, ...)
+    void appearanceChanged()
     {
-        return vertices;
+        if (staticBatch >= 0)
+        {
+            World::getInstance().staticShapeChanged(this);
+        }
     }
 
-    Vector4 getColor() const
+    void invalidateBounds()
     {
-        return color;
+        worldBoundsDirty = true;
+        boundsChanged();
     }
 
-    GLFWwindow *getWindow() const
+    void transformChanged()
     {
-        return window;
+        modelDirty = true;
+        model2DDirty = true;
+        invalidateBounds();
     }
 
-    GLuint getShader() const
+    // Sends whichever model the program takes
+    void setModelUniform() const
     {
-        return shader;
+        if (shader->takesModel2D())
+        {
+            shader->setModel(getModel2D());
+        }
+        else
+        {
+            shader->setModel(getModel());
+        }
     }
 
-    virtual void draw()
+    VertexFormat vertexFormat() const
     {
-        if (!World::isBound(this))
+        bool flat = raisedVertices == 0 && World::getInstance().is2DMode();
+        if (hasVertexColors())
         {
-            return;
+            return flat ? VertexFormat::Position2DColor : VertexFormat::PositionColor;
         }
-        if (!initialized)
+        return flat ? VertexFormat::Position2D : VertexFormat::Position;
+    }
+
+    void countRaisedVertices()
+    {
+        raisedVertices = 0;
+        for (const Vector3 &v : vertices)
         {
-            init();
-            initialized = true;
+            raisedVertices += v.z != 0.0f;
         }
+    }
 
-        glBindVertexArray(Vertex_Array_Object); // register VAO as current
-        GLuint colorLoc = glGetUniformLocation(shader, "uColor");
-        glUniform4f(colorLoc, color.x, color.y, color.z, color.w);
-
-        World &world = World::getInstance();
-        Vector3 worldSize = world.getWorldSize();
-
-        Mat4 proj = Mat4::ortho(0.0f, worldSize.x, 0.0f, worldSize.y, -1.0f, 1.0f);
-        Mat4 view;
-        view.loadIdentity();
-
-        Mat4 MVP = proj * view * model;
-        GLuint mvpLoc = glGetUniformLocation(shader, "uMVP");
-        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, MVP.m);
+    bool usesPool() const
+    {
+        return pooled && usage != BufferUsage::Stream;
+    }
 
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size()); // draw the vertexs in triangle mode
-        glBindVertexArray(0);                           // clear VAO context
+    // Stream shapes write a fresh copy into the StreamRing every frame
+    // when it is available, and orphan a private buffer otherwise
+    bool usesRing() const
+    {
+        return pooled && usage == BufferUsage::Stream && StreamRing::getInstance().isEnabled();
     }
-    CompoundShape *bind(Shape &other);
-};
 
-class CompoundShape : public Shape
-{
-private:
-    std::vector<int> shapeIndacies;
-    std::vector<Vector4> shapeColors;
-    CompoundShape(GLFWwindow *window, GLuint shader)
-        : Shape(window, shader)
+    bool inRing() const
     {
+        return ringFrame != 0 && ringFrame == StreamRing::getInstance().getFrame();
     }
 
-public:
-    static CompoundShape *bindShapes(const std::vector<Shape *> &shapes)
+    // Identifies the vertex array the next draw binds: pooled and streamed
+    // shapes share one per format, the rest have their own
+    uint32_t meshKey() const
     {
-        CompoundShape *compoundShape = new CompoundShape(shapes[0]->getWindow(), shapes[0]->getShader());
-        for (const auto &shape : shapes)
+        if (usesPool())
         {
-            for (const auto &v : shape->getVertices())
-            {
-                compoundShape->addVertex(v);
-            }
-            compoundShape->shapeIndacies.push_back(shape->getVertices().size());
-            compoundShape->shapeColors.push_back(shape->getColor());
+            return (uint32_t)vertexFormat();
         }
-        compoundShape->setColor(Vector4::one());
-        return compoundShape;
+        return vertexFormatCount + (usesRing() ? StreamRing::getInstance().vertexArrayOf(vertexFormat()) : vertexArray.id());
     }
 
-    std::vector<int> *getShapeIndacies()
+    // True once the current storage holds everything the next draw needs
+    bool uploaded() const
     {
-        return &shapeIndacies;
+        bool stored;
+        if (usesPool())
+        {
+            stored = GeometryPool::getInstance().contains(poolVertices);
+        }
+        else if (usesRing())
+        {
+            stored = inRing(); // last frame's copy may already be overwritten
+        }
+        else
+        {
+            stored = vertexArray.valid();
+        }
+        return stored && dirtyRanges.empty() && !indicesDirty && vertexFormat() == uploadedFormat;
     }
 
-    std::vector<Vector4> *getShapeColors()
+    void writeVertexBytes(size_t byteOffset, size_t bytes, const void *data)
     {
-        return &shapeColors;
+        if (usesPool())
+        {
+            GeometryPool::getInstance().write(poolVertices, byteOffset, bytes, data);
+        }
+        else
+        {
+            vertexBuffer.update(byteOffset, bytes, data); // expects the VBO bound
+        }
     }
 
-    void draw() override
+    // Copies vertices [begin, end) to the GPU in the current layout
+    void uploadVertices(size_t begin, size_t end)
     {
-        if (!World::isBound(this))
+        VertexFormat format = vertexFormat();
+        size_t stride = vertexStride(format);
+        if (format == VertexFormat::Position)
         {
+            writeVertexBytes(begin * stride, (end - begin) * stride, vertices.data() + begin);
             return;
         }
-        if (!initialized)
+        static std::vector<uint8_t> staging; // shared scratch, uploads only happen on the GL thread
+        staging.resize((end - begin) * stride);
+        packVertices(staging.data(), begin, end, format);
+        writeVertexBytes(begin * stride, staging.size(), staging.data());
+    }
+
+    // Writes vertices [begin, end) into `out` in the layout of `format`:
+    // positions, narrowed to xy for the 2D formats, interleaved with
+    // their colors for the color formats
+    void packVertices(uint8_t *out, size_t begin, size_t end, VertexFormat format) const
+    {
+        switch (format)
         {
-            init();
-            initialized = true;
+        case VertexFormat::Position:
+            std::copy(vertices.begin() + begin, vertices.begin() + end, reinterpret_cast<Vector3 *>(out));
+            break;
+        case VertexFormat::Position2D:
+        {
+            Vector2 *v = reinterpret_cast<Vector2 *>(out);
+            for (size_t i = begin; i < end; i++)
+            {
+                v[i - begin] = Vector2(vertices[i].x, vertices[i].y);
+            }
+            break;
         }
-
-        glBindVertexArray(Vertex_Array_Object);
-
+        case VertexFormat::PositionColor:
+        {
+            ColorVertex *v = reinterpret_cast<ColorVertex *>(out);
+            for (size_t i = begin; i < end; i++)
+            {
+                v[i - begin].position = vertices[i];
+                packColor(vertexColors[i], v[i - begin].color);
+            }
+            break;
+        }
+        case VertexFormat::Position2DColor:
+        {
+            ColorVertex2D *v = reinterpret_cast<ColorVertex2D *>(out);
+            for (size_t i = begin; i < end; i++)
+            {
+                v[i - begin].position = Vector2(vertices[i].x, vertices[i].y);
+                packColor(vertexColors[i], v[i - begin].color);
+            }
+            break;
+        }
+        }
+    }
+
+    static void packColor(const Vector4 &c, uint8_t out[4])
+    {
+        out[0] = packColor(c.x);
+        out[1] = packColor(c.y);
+        out[2] = packColor(c.z);
+        out[3] = packColor(c.w);
+    }
+
+    static uint8_t packColor(float v)
+    {
+        return (uint8_t)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // 16-bit indices while every vertex is addressable with them. Returns
+    // the index data in that width, or nullptr when nothing needs sending;
+    // `scratch` backs the narrowed copy.
+    const void *prepareIndices(std::vector<uint16_t> &scratch, size_t &bytes)
+    {
+        GLenum neededType = vertices.size() > 0xFFFF ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        if (neededType != indexType)
+        {
+            indexType = neededType;
+            indicesDirty = true;
+        }
+        if (!indicesDirty || indices.empty())
+        {
+            bytes = 0;
+            return nullptr;
+        }
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            scratch.assign(indices.begin(), indices.end());
+            bytes = scratch.size() * sizeof(uint16_t);
+            return scratch.data();
+        }
+        bytes = indices.size() * sizeof(uint32_t);
+        return indices.data();
+    }
+
+    // Uploads into this shape's ranges of the GeometryPool, moving to
+    // bigger ranges (or another format's buffers) when needed
+    void initPooled()
+    {
+        GeometryPool &pool = GeometryPool::getInstance();
+        vertexArray.release(); // storage may have been private before
+        vertexBuffer.release();
+        indexBuffer.release();
+
+        VertexFormat format = vertexFormat();
+        bool moved = !pool.contains(poolVertices) || format != uploadedFormat ||
+                     pool.capacityOf(poolVertices) < vertices.size();
+        if (moved)
+        {
+            // Exact fit first; growing shapes get room to keep growing
+            bool growing = pool.contains(poolVertices) && pool.capacityOf(poolVertices) < vertices.size();
+            size_t capacity = growing ? std::max(vertices.size(), pool.capacityOf(poolVertices) * 2) : vertices.size();
+            pool.free(poolVertices);
+            poolVertices = pool.allocate(format, GeometryPool::Space::Vertices, capacity);
+            uploadVertices(0, vertices.size());
+            uploadedFormat = format;
+            if (!pool.contains(poolIndices) || pool.formatOf(poolIndices) != format)
+            {
+                indicesDirty = true; // index ranges belong to one format's buffers
+            }
+        }
+        else
+        {
+            for (const auto &range : dirtyRanges)
+            {
+                uploadVertices(range.begin, range.end); // only the edited vertices
+            }
+        }
+        dirtyRanges.clear();
+
+        std::vector<uint16_t> narrow;
+        size_t bytes = 0;
+        const void *data = prepareIndices(narrow, bytes);
+        if (data != nullptr)
+        {
+            size_t units = (bytes + 3) / 4;
+            if (!pool.contains(poolIndices) || pool.formatOf(poolIndices) != format || pool.capacityOf(poolIndices) < units)
+            {
+                pool.free(poolIndices);
+                poolIndices = pool.allocate(format, GeometryPool::Space::Indices, units);
+            }
+            pool.write(poolIndices, 0, bytes, data);
+        }
+        indicesDirty = false;
+    }
+
+    // Uploads the dirty vertex ranges into the shape's own VAO/VBO
+    void initPrivate()
+    {
+        GeometryPool::getInstance().free(poolVertices); // storage may have been pooled before
+        GeometryPool::getInstance().free(poolIndices);
+        poolVertices = poolIndices = GeometryHandle();
+
+        bool created = vertexArray.create(); // Create VAO on first use
+        if (created)
+        {
+            indicesDirty = true; // the EBO is new as well
+        }
+
+        vertexArray.bind(); // register VAO as current
+
+        VertexFormat format = vertexFormat();
+        size_t bytes = vertices.size() * vertexStride(format);
+        bool reallocated = vertexBuffer.reserve(bytes, glBufferUsage(usage)); // grow the VBO if needed (creates and binds it)
+        if (!reallocated && usage == BufferUsage::Stream)
+        {
+            vertexBuffer.orphan();
+            reallocated = true;
+        }
+
+        bool layoutChanged = created || format != uploadedFormat;
+        if (reallocated || layoutChanged)
+        {
+            uploadVertices(0, vertices.size()); // storage is fresh or its layout changed, send everything
+        }
+        else
+        {
+            for (const auto &range : dirtyRanges)
+            {
+                uploadVertices(range.begin, range.end); // only the edited vertices
+            }
+        }
+        dirtyRanges.clear();
+
+        if (layoutChanged)
+        {
+            specifyVertexFormat(format);
+            uploadedFormat = format;
+        }
+
+        std::vector<uint16_t> narrow;
+        size_t indexBytes = 0;
+        const void *indexData = prepareIndices(narrow, indexBytes);
+        if (indexData != nullptr)
+        {
+            indexBuffer.reserve(indexBytes, glBufferUsage(usage)); // binds the EBO to the VAO
+            indexBuffer.update(0, indexBytes, indexData);
+        }
+        indicesDirty = false;
+    }
+
+    void init()
+    {
+        // A streamed copy expires every frame; rewriting unchanged geometry
+        // isn't an edit and mustn't keep the shape in the Stream class
+        bool refresh = usesRing() && dirtyRanges.empty() && !indicesDirty && vertexFormat() == uploadedFormat;
+        if (!storageMoved && !refresh)
+        {
+            recordUpload();
+        }
+        storageMoved = false;
+        if (usesPool())
+        {
+            initPooled();
+        }
+        else if (!usesRing() || !initStreamed())
+        {
+            initPrivate(); // the ring is full this frame
+        }
+    }
+
+    // Writes this frame's copy of the geometry straight into the mapped
+    // StreamRing region. Returns false when it doesn't fit.
+    bool initStreamed()
+    {
+        StreamRing &ring = StreamRing::getInstance();
+        VertexFormat format = vertexFormat();
+        size_t stride = vertexStride(format);
+        GLenum type = vertices.size() > 0xFFFF ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        size_t indexSize = type == GL_UNSIGNED_INT ? sizeof(uint32_t) : sizeof(uint16_t);
+        size_t vertexOffset = 0;
+        size_t indexOffset = 0;
+        uint8_t *vertexOut = ring.allocate(vertices.size() * stride, stride, vertexOffset);
+        uint8_t *indexOut = nullptr;
+        if (vertexOut != nullptr && isIndexed())
+        {
+            indexOut = ring.allocate(indices.size() * indexSize, sizeof(uint32_t), indexOffset);
+        }
+        if (vertexOut == nullptr || (isIndexed() && indexOut == nullptr))
+        {
+            indicesDirty = true; // the private buffers may be stale
+            return false;
+        }
+
+        packVertices(vertexOut, 0, vertices.size(), format);
+        if (type == GL_UNSIGNED_SHORT)
+        {
+            std::copy(indices.begin(), indices.end(), reinterpret_cast<uint16_t *>(indexOut));
+        }
+        else
+        {
+            std::copy(indices.begin(), indices.end(), reinterpret_cast<uint32_t *>(indexOut));
+        }
+        GpuResources::getInstance().recordUpload(vertices.size() * stride + indices.size() * indexSize);
+
+        // Nothing else holds the geometry any more
+        GeometryPool::getInstance().free(poolVertices);
+        GeometryPool::getInstance().free(poolIndices);
+        poolVertices = poolIndices = GeometryHandle();
+        vertexArray.release();
+        vertexBuffer.release();
+        indexBuffer.release();
+
+        indexType = type;
+        uploadedFormat = format;
+        ringFrame = ring.getFrame();
+        ringVertexOffset = vertexOffset;
+        ringIndexOffset = indexOffset;
+        dirtyRanges.clear();
+        indicesDirty = false;
+        return true;
+    }
+
+public:
+    Shape(GLFWwindow *window, ShaderProgram *shader)
+    {
+        this->window = window;
+        this->shader = shader;
+        model.loadIdentity();
+    }
+    // GL objects are handed back to GpuResources and freed on its next collect()
+    virtual ~Shape()
+    {
+        World::getInstance().unbindShape(this);
+        GeometryPool::getInstance().free(poolVertices);
+        GeometryPool::getInstance().free(poolIndices);
+    }
+    void addVertex(const Vector3 &v1)
+    {
+        vertices.push_back(v1);
+        raisedVertices += v1.z != 0.0f;
+        if (hasVertexColors())
+        {
+            vertexColors.push_back(Vector4::one());
+        }
+        markDirty(vertices.size() - 1, vertices.size());
+        localBounds.expand(v1);
+        invalidateBounds();
+    }
+    void setVertex(int index, const Vector3 &v)
+    {
+        if (index >= 0 && index < vertices.size())
+        {
+            if (localBounds.touches(vertices[index]))
+            {
+                localBoundsDirty = true; // the old position may have been the extreme
+            }
+            raisedVertices -= vertices[index].z != 0.0f;
+            raisedVertices += v.z != 0.0f;
+            vertices[index] = v;
+            markDirty(index, index + 1);
+            localBounds.expand(v);
+            invalidateBounds();
+        }
+        else
+        {
+            addVertex(v);
+        }
+    }
+
+    void addVertex(const Vector3 &v, const Vector4 &c)
+    {
+        addVertex(v);
+        setVertexColor(vertices.size() - 1, c);
+    }
+
+    // The first call switches the shape to the interleaved layout, with
+    // every other vertex white (so the shape color shows unchanged)
+    void setVertexColor(size_t index, const Vector4 &c)
+    {
+        if (index >= vertices.size())
+        {
+            return;
+        }
+        if (!hasVertexColors())
+        {
+            vertexColors.assign(vertices.size(), Vector4::one());
+        }
+        vertexColors[index] = c;
+        markDirty(index, index + 1);
+        appearanceChanged();
+    }
+
+    bool hasVertexColors() const
+    {
+        return !vertexColors.empty();
+    }
+
+    const std::vector<Vector4> &getVertexColors() const
+    {
+        return vertexColors;
+    }
+
+    // Back to bare positions; the next draw re-uploads everything
+    void clearVertexColors()
+    {
+        vertexColors.clear();
+        appearanceChanged();
+    }
+
+    void clearVertices()
+    {
+        vertices.clear();
+        raisedVertices = 0;
+        vertexColors.clear();
+        indices.clear();
+        dirtyRanges.clear();
+        indicesDirty = false;
+        localBounds = AABB();
+        localBoundsDirty = false;
+        invalidateBounds();
+    }
+
+    void addIndex(unsigned int i)
+    {
+        indices.push_back(i);
+        indicesDirty = true;
+        appearanceChanged();
+    }
+
+    void addTriangle(unsigned int a, unsigned int b, unsigned int c)
+    {
+        addIndex(a);
+        addIndex(b);
+        addIndex(c);
+    }
+
+    bool isIndexed() const
+    {
+        return !indices.empty();
+    }
+
+    const std::vector<unsigned int> &getIndices() const
+    {
+        return indices;
+    }
+
+    // Pins the storage class; Stream orphans a private buffer on every
+    // upload instead of patching ranges in place
+    void setUsage(BufferUsage u)
+    {
+        usagePinned = true;
+        changeUsage(u);
+    }
+
+    // Lets the storage class follow the upload rate again
+    void setAutoUsage()
+    {
+        usagePinned = false;
+    }
+
+    bool isUsagePinned() const
+    {
+        return usagePinned;
+    }
+
+    // Current storage class, see bufferUsageName() for profiling output
+    BufferUsage getUsage() const
+    {
+        return usage;
+    }
+
+    // Frames among the last 32 in which the geometry was uploaded
+    int getRecentUploads() const
+    {
+        uint32_t v = uploadHistory - ((uploadHistory >> 1) & 0x55555555u);
+        v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+        return (int)((((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+    }
+
+    void setColor(const Vector4 &c)
+    {
+        color = c;
+        appearanceChanged();
+    }
+
+    // Shapes on a lower layer are drawn first; within a layer the World
+    // orders draws to share state
+    void setLayer(int l)
+    {
+        layer = l;
+        appearanceChanged();
+    }
+
+    int getLayer() const
+    {
+        return layer;
+    }
+
+    // See World::setStatic
+    bool isStatic() const
+    {
+        return staticBatch >= 0;
+    }
+
+    // Whether World may merge this shape into a static batch
+    virtual bool isBatchable() const
+    {
+        return true;
+    }
+
+    void triangle_of(float a, float b, float c)
+    {
+        clearVertices();
+
+        Vector3 A(0, 0, 0);
+        Vector3 B(c, 0, 0);
+
+        float x = (b * b + c * c - a * a) / (2 * c);
+        float y = sqrt(b * b - x * x);
+
+        Vector3 C(x, y, 0);
+
+        addVertex(A);
+        addVertex(B);
+        addVertex(C);
+    }
+
+    void square(float size)
+    {
+        clearVertices();
+
+        Vector3 A(0, 0, 0);
+        Vector3 B(size, 0, 0);
+        Vector3 C(size, size, 0);
+        Vector3 D(0, size, 0);
+
+        addVertex(A);
+        addVertex(B);
+        addVertex(C);
+        addVertex(D);
+
+        addTriangle(0, 1, 2);
+        addTriangle(0, 2, 3);
+    }
+
+    void rectangle(float width, float height)
+    {
+        clearVertices();
+
+        Vector3 A(0, 0, 0);
+        Vector3 B(width, 0, 0);
+        Vector3 C(width, height, 0);
+        Vector3 D(0, height, 0);
+
+        addVertex(A);
+        addVertex(B);
+        addVertex(C);
+        addVertex(D);
+
+        addTriangle(0, 1, 2);
+        addTriangle(0, 2, 3);
+    }
+
+    void regularPolygon(int sides, float radius)
+    {
+        clearVertices();
+        if (sides < 3)
+            return;
+
+        float angleStep = 2.0f * 3.14159265359f / sides;
+
+        addVertex(Vector3(0, 0, 0)); // center, shared by every triangle of the fan
+
+        for (int i = 0; i < sides; i++)
+        {
+            float angle = i * angleStep;
+            addVertex(Vector3(radius * cos(angle), radius * sin(angle), 0));
+        }
+
+        for (int i = 0; i < sides; i++)
+        {
+            addTriangle(0, i + 1, (i + 1) % sides + 1);
+        }
+    }
+
+    void translate(const Vector3 &p)
+    {
         World &world = World::getInstance();
-        Vector3 worldSize = world.getWorldSize();
+        Vector3 delta = p;
+        if (!world.translateCallback(this, delta)) // may shorten delta on contact
+        {
+            return;
+        }
+        position += delta;
+        modelDirty = true;
+        model2DDirty = true;
+        if (!worldBoundsDirty)
+        {
+            worldBounds = worldBounds.translated(delta);
+        }
+        boundsChanged();
+    }
+
+    void setPos(const Vector3 &p)
+    {
+        position = p;
+        transformChanged();
+    }
+
+    Vector3 getPos() const
+    {
+        return position;
+    }
+
+    void setScale(float s)
+    {
+        setScale(Vector3(s, s, s));
+    }
+
+    void setScale(const Vector3 &s)
+    {
+        scale = s;
+        transformChanged();
+    }
+
+    Vector3 getScale() const
+    {
+        return scale;
+    }
+
+    void setRotation(float radians)
+    {
+        rotation = radians;
+        transformChanged();
+    }
+
+    void rotate(float radians)
+    {
+        setRotation(rotation + radians);
+    }
+
+    float getRotation() const
+    {
+        return rotation;
+    }
+
+    const Mat4 &getModel() const
+    {
+        if (modelDirty)
+        {
+            model = Mat4::compose(position, rotation, scale);
+            modelDirty = false;
+        }
+        return model;
+    }
+
+    // The xy part of getModel(), built directly; z translation and scale
+    // are dropped, which is what a flat shape in a 2D program sees anyway
+    const Mat3x2 &getModel2D() const
+    {
+        if (model2DDirty)
+        {
+            model2D = Mat3x2::compose(Vector2(position.x, position.y), rotation, Vector2(scale.x, scale.y));
+            model2DDirty = false;
+        }
+        return model2D;
+    }
+
+    // Vertices in local space; apply getModel() for world positions
+    const std::vector<Vector3> &getVertices() const
+    {
+        return vertices;
+    }
+
+    virtual const AABB &getLocalBounds() const
+    {
+        if (localBoundsDirty)
+        {
+            localBounds = AABB::fromPoints(vertices.data(), vertices.size());
+            localBoundsDirty = false;
+        }
+        return localBounds;
+    }
+
+    // World-space bounds of the transformed shape
+    const AABB &getBounds() const
+    {
+        if (worldBoundsDirty || localBoundsDirty)
+        {
+            worldBounds = getLocalBounds().transformed(getModel());
+            worldBoundsDirty = false;
+        }
+        return worldBounds;
+    }
+
+    Vector4 getColor() const
+    {
+        return color;
+    }
+
+    GLFWwindow *getWindow() const
+    {
+        return window;
+    }
+
+    ShaderProgram *getShader() const
+    {
+        return shader;
+    }
+
+    ShapeHandle getHandle() const
+    {
+        return handle;
+    }
+
+    virtual void draw()
+    {
+        if (!World::isBound(this))
+        {
+            return;
+        }
+        if (!uploaded())
+        {
+            init();
+        }
+
+        if (usesPool())
+        {
+            drawPooled();
+            return;
+        }
+        if (usesRing() && inRing())
+        {
+            drawStreamed();
+            return;
+        }
+
+        vertexArray.bind(); // register VAO as current
+        shader->setColor(color);
+        setModelUniform();
+
+        if (isIndexed())
+        {
+            glDrawElements(GL_TRIANGLES, indices.size(), indexType, (void *)0); // draw the indexed triangles
+        }
+        else
+        {
+            glDrawArrays(GL_TRIANGLES, 0, vertices.size()); // draw the vertexs in triangle mode
+        }
+    }
+    CompoundShape *bind(Shape &other);
+
+protected:
+    // Draws this frame's copy out of the StreamRing
+    void drawStreamed()
+    {
+        if (vertices.empty())
+        {
+            return;
+        }
+        StreamRing::getInstance().bind(uploadedFormat);
+        shader->setColor(color);
+        setModelUniform();
+
+        GLint baseVertex = (GLint)(ringVertexOffset / vertexStride(uploadedFormat));
+        if (isIndexed())
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), indexType, (void *)ringIndexOffset, baseVertex);
+        }
+        else
+        {
+            glDrawArrays(GL_TRIANGLES, baseVertex, vertices.size());
+        }
+    }
+
+    // Draws this shape's ranges out of the shared buffers
+    void drawPooled()
+    {
+        if (vertices.empty())
+        {
+            return;
+        }
+        GeometryPool &pool = GeometryPool::getInstance();
+        pool.bind(uploadedFormat);
+        shader->setColor(color);
+        setModelUniform();
+
+        GLint baseVertex = (GLint)pool.offsetOf(poolVertices);
+        if (isIndexed())
+        {
+            glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), indexType,
+                                     (void *)pool.byteOffsetOf(poolIndices), baseVertex);
+        }
+        else
+        {
+            glDrawArrays(GL_TRIANGLES, baseVertex, vertices.size());
+        }
+    }
+};
+
+class CompoundShape : public Shape
+{
+private:
+    std::vector<int> shapeIndacies;     // index count of each merged shape
+    std::vector<int> shapeVertexCounts; // vertex count of each merged shape
+    std::vector<Vector4> shapeColors;
+    CompoundShape(GLFWwindow *window, ShaderProgram *shader)
+        : Shape(window, shader)
+    {
+    }
+
+public:
+    // Merges the parts into one mesh: transforms are baked into the
+    // positions and each part's color into per-vertex colors, so the whole
+    // compound draws with a single glDrawElements
+    static CompoundShape *bindShapes(const std::vector<Shape *> &shapes)
+    {
+        CompoundShape *compoundShape = new CompoundShape(shapes[0]->getWindow(), shapes[0]->getShader());
+        std::vector<MeshPart> parts;
+        for (const auto &shape : shapes)
+        {
+            MeshPart part; // bake each part's transform and color into the merged mesh
+            part.vertices = shape->getVertices().data();
+            part.vertexCount = shape->getVertices().size();
+            part.vertexColors = shape->hasVertexColors() ? shape->getVertexColors().data() : nullptr;
+            part.indices = shape->getIndices().data();
+            part.indexCount = shape->getIndices().size();
+            part.model = shape->getModel();
+            part.color = shape->getColor();
+            parts.push_back(part);
+
+            // Unindexed parts get 0..n-1 in the merged mesh
+            compoundShape->shapeIndacies.push_back(shape->isIndexed() ? shape->getIndices().size() : shape->getVertices().size());
+            compoundShape->shapeVertexCounts.push_back(shape->getVertices().size());
+            compoundShape->shapeColors.push_back(shape->getColor());
+        }
+        MergedMesh merged;
+        mergeMeshes(parts, merged);
+        compoundShape->vertices.swap(merged.vertices);
+        compoundShape->countRaisedVertices();
+        compoundShape->vertexColors.swap(merged.colors);
+        compoundShape->indices.swap(merged.indices);
+        compoundShape->indicesDirty = true;
+        compoundShape->localBounds = merged.bounds;
+        if (!compoundShape->vertices.empty())
+        {
+            compoundShape->markDirty(0, compoundShape->vertices.size());
+        }
+        compoundShape->invalidateBounds();
+        compoundShape->setColor(Vector4::one());
+        return compoundShape;
+    }
+
+    std::vector<int> *getShapeIndacies()
+    {
+        return &shapeIndacies;
+    }
+
+    // Colors the parts had when merged; recolor through setShapeColor
+    const std::vector<Vector4> *getShapeColors() const
+    {
+        return &shapeColors;
+    }
+
+    // Repaints one part, re-uploading only that part's vertices
+    void setShapeColor(size_t part, const Vector4 &c)
+    {
+        if (part >= shapeColors.size())
+        {
+            return;
+        }
+        size_t begin = 0;
+        for (size_t i = 0; i < part; i++)
+        {
+            begin += shapeVertexCounts[i];
+        }
+        size_t end = begin + shapeVertexCounts[part];
+        for (size_t i = begin; i < end; i++)
+        {
+            vertexColors[i] = c;
+        }
+        if (end > begin)
+        {
+            markDirty(begin, end);
+        }
+        shapeColors[part] = c;
+    }
+};
+
+// Many copies of one mesh drawn with a single instanced call. The mesh is
+// built with the usual Shape methods; each instance adds its own
+// transform (applied before the shape's) and color, kept in a per-instance
+// vertex buffer that only re-uploads instances edited since the last draw.
+// The World sees the union of all instances, and draw() culls them
+// individually against the view.
+// Its program reads the instance attributes (aInstanceModel at
+// locations 2-5, or 2-4 as a mat3x2 alongside a mat3x2 uModel, and
+// aInstanceColor at 6); see instancedVertexShaderSrc in main.cpp.
+class InstancedShape : public Shape
+{
+public:
+    struct Instance
+    {
+        Vector3 position;
+        float rotation = 0.0f; // radians about z
+        Vector3 scale = Vector3::one();
+        Vector4 color = Vector4::one();
+    };
+
+private:
+    // Per-instance attributes as the shader reads them, packed per
+    // instance: the model matrix columns (locations instanceModelAttribute
+    // and up), then the color. The model is a mat4, or a mat3x2 when the
+    // program takes 2D transforms (ShaderProgram::takesModel2D()).
+    size_t modelFloats = 16;
+
+    size_t instanceFloats() const
+    {
+        return modelFloats + 4;
+    }
+
+    SlotMap<Instance> instances;
+    std::vector<float> instanceData;  // same dense order as instances, instanceFloats() each
+    std::vector<AABB> instanceBounds; // mesh bounds under each instance transform, shape-local
+    size_t dirtyBegin = 0;            // instanceData range [dirtyBegin, dirtyEnd) not yet uploaded
+    size_t dirtyEnd = 0;
+
+    GpuBuffer instanceBuffer;
+    bool instanceAttributesSet = false;
+    bool uploadedAll = false; // buffer mirrors instanceData rather than last frame's visible subset
+
+    mutable AABB meshBounds; // mesh bounds the instance boxes were computed from
+    mutable AABB unionBounds;
+    mutable bool unionDirty = false;
+
+    // World-space boxes of every instance for culling, rebuilt lazily
+    std::vector<float> cullMinX, cullMinY, cullMaxX, cullMaxY;
+    Mat4 cullModel;
+    bool cullDirty = true;
+    std::vector<uint32_t> visibleList;
+    std::vector<float> staging;
+
+    static bool sameBox(const AABB &a, const AABB &b)
+    {
+        return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+               a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+    }
+
+    void markInstanceDirty(size_t dense)
+    {
+        if (dirtyBegin >= dirtyEnd)
+        {
+            dirtyBegin = dense;
+            dirtyEnd = dense + 1;
+        }
+        else
+        {
+            dirtyBegin = std::min(dirtyBegin, dense);
+            dirtyEnd = std::max(dirtyEnd, dense + 1);
+        }
+    }
+
+    // Recomputes the GPU data and box of one instance
+    void rebuildInstance(size_t dense)
+    {
+        const Instance &inst = instances[dense];
+        Mat4 m = Mat4::compose(inst.position, inst.rotation, inst.scale);
+        float *data = instanceData.data() + dense * instanceFloats();
+        if (modelFloats == 6)
+        {
+            Mat3x2 m2 = Mat3x2::compose(Vector2(inst.position.x, inst.position.y), inst.rotation,
+                                        Vector2(inst.scale.x, inst.scale.y));
+            std::copy(m2.m, m2.m + 6, data);
+        }
+        else
+        {
+            std::copy(m.m, m.m + 16, data);
+        }
+        std::memcpy(data + modelFloats, &inst.color, sizeof(Vector4));
+        instanceBounds[dense] = meshBounds.transformed(m);
+        markInstanceDirty(dense);
+    }
+
+    void instanceChanged(size_t dense)
+    {
+        rebuildInstance(dense);
+        unionDirty = true;
+        cullDirty = true;
+        invalidateBounds();
+    }
+
+    // Picks up mesh edits, which move every instance's box. The mesh edit
+    // already invalidated the world bounds, so this only refreshes caches.
+    void syncMeshBounds() const
+    {
+        const AABB &mesh = Shape::getLocalBounds();
+        if (sameBox(mesh, meshBounds))
+        {
+            return;
+        }
+        meshBounds = mesh;
+        InstancedShape *self = const_cast<InstancedShape *>(this); // cached data only
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            self->rebuildInstance(i);
+        }
+        self->cullDirty = true;
+        unionDirty = true;
+    }
+
+    void updateCullBounds()
+    {
+        const Mat4 &m = getModel();
+        if (!cullDirty && std::equal(m.m, m.m + 16, cullModel.m))
+        {
+            return;
+        }
+        size_t count = instanceBounds.size();
+        cullMinX.resize(count);
+        cullMinY.resize(count);
+        cullMaxX.resize(count);
+        cullMaxY.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            AABB box = instanceBounds[i].transformed(m);
+            cullMinX[i] = box.min.x;
+            cullMinY[i] = box.min.y;
+            cullMaxX[i] = box.max.x;
+            cullMaxY[i] = box.max.y;
+        }
+        cullModel = m;
+        cullDirty = false;
+    }
+
+    // Makes the instance buffer hold what this frame draws; returns the
+    // instance count to draw
+    size_t uploadInstances()
+    {
+        visibleList.resize(instances.size());
+        size_t visible = instances.size();
+        if (World::getInstance().isCullingEnabled())
+        {
+            updateCullBounds();
+            visible = cullRects(cullMinX.data(), cullMinY.data(), cullMaxX.data(), cullMaxY.data(),
+                                instances.size(), World::getInstance().getViewBounds(), visibleList.data());
+        }
+        visibleList.resize(visible);
+
+        size_t floats = instanceFloats();
+        size_t stride = floats * sizeof(float);
+        size_t bytes = instances.size() * stride;
+        if (visible == instances.size())
+        {
+            bool reallocated = instanceBuffer.reserve(bytes, GL_DYNAMIC_DRAW);
+            if (reallocated || !uploadedAll)
+            {
+                instanceBuffer.update(0, bytes, instanceData.data());
+            }
+            else if (dirtyBegin < dirtyEnd)
+            {
+                instanceBuffer.update(dirtyBegin * stride, (dirtyEnd - dirtyBegin) * stride,
+                                      instanceData.data() + dirtyBegin * floats); // only the edited instances
+            }
+            uploadedAll = true;
+            dirtyBegin = dirtyEnd = 0;
+        }
+        else if (visible > 0)
+        {
+            // Partly on screen: send just the visible instances this frame
+            staging.resize(visible * floats);
+            for (size_t i = 0; i < visible; i++)
+            {
+                std::copy_n(instanceData.data() + visibleList[i] * floats, floats, staging.data() + i * floats);
+            }
+            if (!instanceBuffer.reserve(bytes, GL_DYNAMIC_DRAW))
+            {
+                instanceBuffer.orphan();
+            }
+            instanceBuffer.update(0, visible * stride, staging.data());
+            uploadedAll = false; // the next full upload sends everything
+            dirtyBegin = dirtyEnd = 0;
+        }
+        // With nothing visible nothing is sent, and edits stay pending
+        return visible;
+    }
+
+    // Per-instance attributes advance once per instance, not per vertex
+    void specifyInstanceAttributes()
+    {
+        vertexArray.bind();
+        GLsizei stride = (GLsizei)(instanceFloats() * sizeof(float));
+        instanceBuffer.reserve(std::max<size_t>(instances.size(), 1) * stride, GL_DYNAMIC_DRAW);
+        GLuint columns = modelFloats == 6 ? 3 : 4; // mat3x2 or mat4
+        GLint rows = modelFloats == 6 ? 2 : 4;
+        for (GLuint col = 0; col < columns; col++)
+        {
+            GLuint location = ShaderProgram::instanceModelAttribute + col;
+            glVertexAttribPointer(location, rows, GL_FLOAT, GL_FALSE, stride, (void *)(col * rows * sizeof(float)));
+            GLState::getInstance().enableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glVertexAttribPointer(ShaderProgram::instanceColorAttribute, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void *)(modelFloats * sizeof(float)));
+        GLState::getInstance().enableVertexAttribArray(ShaderProgram::instanceColorAttribute);
+        glVertexAttribDivisor(ShaderProgram::instanceColorAttribute, 1);
+        uploadedAll = false; // storage may be fresh
+        instanceAttributesSet = true;
+    }
+
+public:
+    InstancedShape(GLFWwindow *window, ShaderProgram *shader)
+        : Shape(window, shader)
+    {
+        pooled = false; // the instance attributes need a VAO of their own
+        if (shader != nullptr && shader->takesModel2D())
+        {
+            modelFloats = 6;
+        }
+    }
+
+    // The instances live in their own buffer, not in the vertices
+    bool isBatchable() const override
+    {
+        return false;
+    }
+
+    InstanceHandle addInstance(const Vector3 &position, const Vector4 &color = Vector4::one(),
+                               float rotation = 0.0f, const Vector3 &scale = Vector3::one())
+    {
+        syncMeshBounds();
+        Instance inst;
+        inst.position = position;
+        inst.rotation = rotation;
+        inst.scale = scale;
+        inst.color = color;
+        InstanceHandle h = instances.insert(inst);
+        instanceData.resize(instanceData.size() + instanceFloats());
+        instanceBounds.emplace_back();
+        instanceChanged(instances.size() - 1);
+        return h;
+    }
+
+    // Swap-removes like the World does; the last instance moves into the gap
+    bool removeInstance(InstanceHandle h)
+    {
+        uint32_t dense = instances.denseIndex(h);
+        if (dense == SlotHandle::npos)
+        {
+            return false;
+        }
+        instances.erase(h);
+        size_t floats = instanceFloats();
+        std::copy_n(instanceData.end() - floats, floats, instanceData.begin() + dense * floats);
+        instanceData.resize(instanceData.size() - floats);
+        instanceBounds[dense] = instanceBounds.back();
+        instanceBounds.pop_back();
+        if (dense < instances.size())
+        {
+            markInstanceDirty(dense);
+        }
+        unionDirty = true;
+        cullDirty = true;
+        invalidateBounds();
+        return true;
+    }
+
+    void clearInstances()
+    {
+        instances.clear();
+        instanceData.clear();
+        instanceBounds.clear();
+        dirtyBegin = dirtyEnd = 0;
+        unionDirty = true;
+        cullDirty = true;
+        invalidateBounds();
+    }
+
+    bool isValid(InstanceHandle h) const
+    {
+        return instances.contains(h);
+    }
+
+    const Instance *getInstance(InstanceHandle h) const
+    {
+        return instances.get(h);
+    }
+
+    void setInstance(InstanceHandle h, const Instance &value)
+    {
+        uint32_t dense = instances.denseIndex(h);
+        if (dense != SlotHandle::npos)
+        {
+            syncMeshBounds();
+            instances[dense] = value;
+            instanceChanged(dense);
+        }
+    }
+
+    void setInstancePos(InstanceHandle h, const Vector3 &p)
+    {
+        if (const Instance *inst = instances.get(h))
+        {
+            Instance v = *inst;
+            v.position = p;
+            setInstance(h, v);
+        }
+    }
+
+    void setInstanceRotation(InstanceHandle h, float radians)
+    {
+        if (const Instance *inst = instances.get(h))
+        {
+            Instance v = *inst;
+            v.rotation = radians;
+            setInstance(h, v);
+        }
+    }
 
-        Mat4 proj = Mat4::ortho(0.0f, worldSize.x, 0.0f, worldSize.y, -1.0f, 1.0f);
-        Mat4 view;
-        view.loadIdentity();
+    void setInstanceScale(InstanceHandle h, const Vector3 &s)
+    {
+        if (const Instance *inst = instances.get(h))
+        {
+            Instance v = *inst;
+            v.scale = s;
+            setInstance(h, v);
+        }
+    }
 
-        Mat4 MVP = proj * view * model;
-        GLuint mvpLoc = glGetUniformLocation(shader, "uMVP");
-        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, MVP.m);
+    void setInstanceColor(InstanceHandle h, const Vector4 &c)
+    {
+        if (const Instance *inst = instances.get(h))
+        {
+            Instance v = *inst;
+            v.color = c;
+            setInstance(h, v);
+        }
+    }
 
-        GLuint colorLoc = glGetUniformLocation(shader, "uColor");
+    size_t getInstanceCount() const
+    {
+        return instances.size();
+    }
 
-        int vertexOffset = 0; // starting index in the VBO
+    // Instances that passed culling in the last draw()
+    size_t getVisibleInstanceCount() const
+    {
+        return visibleList.size();
+    }
 
-        for (int i = 0; i < shapeIndacies.size(); i++)
+    // Union of every instance, in the shape's local space
+    const AABB &getLocalBounds() const override
+    {
+        syncMeshBounds();
+        if (unionDirty)
         {
-            const Vector4 &shapeColor = shapeColors[i];
-            int vertexCount = shapeIndacies[i];
+            unionBounds = AABB();
+            for (const AABB &box : instanceBounds)
+            {
+                unionBounds.merge(box);
+            }
+            unionDirty = false;
+        }
+        return unionBounds;
+    }
 
-            glUniform4f(colorLoc,
-                        shapeColor.x,
-                        shapeColor.y,
-                        shapeColor.z,
-                        shapeColor.w);
+    void draw() override
+    {
+        if (!World::isBound(this) || vertices.empty())
+        {
+            return;
+        }
+        if (!uploaded())
+        {
+            init();
+        }
+        if (!instanceAttributesSet)
+        {
+            specifyInstanceAttributes();
+        }
+        syncMeshBounds();
+        size_t count = uploadInstances();
+        if (count == 0)
+        {
+            return;
+        }
 
-            glDrawArrays(GL_TRIANGLES, vertexOffset, vertexCount);
+        vertexArray.bind();
+        shader->setColor(color);
+        setModelUniform();
 
-            vertexOffset += vertexCount;
+        if (isIndexed())
+        {
+            glDrawElementsInstanced(GL_TRIANGLES, indices.size(), indexType, (void *)0, count);
+        }
+        else
+        {
+            glDrawArraysInstanced(GL_TRIANGLES, 0, vertices.size(), count);
         }
-
-        glBindVertexArray(0);
     }
 };
 
@@ -418,29 +1925,656 @@ inline CompoundShape *Shape::bind(Shape &other)
     return result;
 }
 
+inline ShapeHandle World::bindShape(std::string_view name, Shape *shape)
+{
+    NameId id = internName(name);
+    if (!isBound(shape))
+    {
+        shape->handle = shapes.insert({shape, id});
+        cullMinX.push_back(0.0f);
+        cullMinY.push_back(0.0f);
+        cullMaxX.push_back(0.0f);
+        cullMaxY.push_back(0.0f);
+        setCullBounds(shapes.denseIndex(shape->handle), shape->getBounds());
+        if (shape->handle.index >= slotShapes.size())
+        {
+            slotShapes.resize(shape->handle.index + 1, nullptr);
+        }
+        slotShapes[shape->handle.index] = shape;
+        broadPhase.insert(shape->handle.index, shape->getBounds());
+        if (shape->handle.index >= treeLeaves.size())
+        {
+            treeLeaves.resize(shape->handle.index + 1, AABBTree::nullNode);
+        }
+        updateTreeLeaf(shape->handle.index, shape->getBounds());
+    }
+    else
+    {
+        BoundShape *bound = shapes.get(shape->handle);
+        if (shapeNames[bound->name] == shape->handle)
+        {
+            shapeNames[bound->name] = ShapeHandle();
+        }
+        bound->name = id;
+    }
+    shapeNames[id] = shape->handle;
+    return shape->handle;
+}
+
+inline bool World::unbindShape(ShapeHandle handle)
+{
+    BoundShape *bound = shapes.get(handle);
+    if (!bound)
+    {
+        return false; // stale or never bound
+    }
+    if (shapeNames[bound->name] == handle)
+    {
+        shapeNames[bound->name] = ShapeHandle();
+    }
+    broadPhase.remove(handle.index);
+    updateTreeLeaf(handle.index, AABB());
+    slotShapes[handle.index] = nullptr;
+    if (bound->shape->staticBatch >= 0)
+    {
+        removeFromStaticBatch(bound->shape);
+    }
+    bound->shape->handle = ShapeHandle();
+    bound->shape->boundsQueued = false;
+
+    // Mirror the slot map's swap-remove in the culling lanes
+    uint32_t dense = shapes.denseIndex(handle);
+    size_t last = cullMinX.size() - 1;
+    cullMinX[dense] = cullMinX[last];
+    cullMinY[dense] = cullMinY[last];
+    cullMaxX[dense] = cullMaxX[last];
+    cullMaxY[dense] = cullMaxY[last];
+    cullMinX.pop_back();
+    cullMinY.pop_back();
+    cullMaxX.pop_back();
+    cullMaxY.pop_back();
+    shapes.erase(handle);
+    return true;
+}
+
+inline bool World::unbindShape(Shape *shape)
+{
+    return unbindShape(shape->handle);
+}
+
+inline bool World::isBound(Shape *shape)
+{
+    const BoundShape *bound = getInstance().shapes.get(shape->handle);
+    return bound && bound->shape == shape;
+}
+
+inline void World::cullShapes()
+{
+    syncBounds();
+    visibleList.resize(shapes.size());
+    if (!cullingEnabled)
+    {
+        for (uint32_t i = 0; i < visibleList.size(); i++)
+        {
+            visibleList[i] = i;
+        }
+        return;
+    }
+    size_t visible = cullRects(cullMinX.data(), cullMinY.data(), cullMaxX.data(), cullMaxY.data(),
+                               shapes.size(), getViewBounds(), visibleList.data());
+    visibleList.resize(visible);
+}
+
+// Ages the upload history of every bound shape, visible or not, so shapes
+// that stop changing while culled or batched still move back to Static
+inline void World::updateShapeUsage()
+{
+    for (uint32_t dense = 0; dense < shapes.size(); dense++)
+    {
+        shapes[dense].shape->updateUsage();
+    }
+}
+
 inline void World::drawAllShapes()
 {
-    for (auto shape : shapes)
+    GLState &state = GLState::getInstance();
+    GLStateStats before = state.getStats();
+    frameIndex++;
+    StreamRing::getInstance().beginFrame();
+    updateFrameConstants();
+    updateShapeUsage(); // before queueing, the sort keys depend on the storage
+    cullShapes();
+    rebuildStaticBatches();
+    queueVisibleShapes();
+    if (isMultiDrawEnabled())
+    {
+        drawIndirect();
+    }
+    else
+    {
+        drawQueued();
+        lastDrawCalls = renderQueue.size();
+    }
+    StreamRing::getInstance().endFrame();
+    renderStats = state.getStats() - before;
+}
+
+// Sorts the visible shapes and static batches by layer, then program,
+// vertex array, color and depth so that neighbours in the queue share as
+// much state as possible
+inline void World::queueVisibleShapes()
+{
+    renderQueue.clear();
+    for (uint32_t dense : visibleList)
+    {
+        Shape *shape = shapes[dense].shape;
+        if (shape->staticBatch >= 0)
+        {
+            continue; // drawn with its batch
+        }
+        renderQueue.add(makeSortKey(shape->layer, shape->shader->id(), shape->meshKey(),
+                                    sortKeyMaterial(shape->color), sortKeyDepth(shape->position.z, worldSize.z)),
+                        dense);
+    }
+    AABB view = getViewBounds();
+    for (uint32_t i = 0; i < staticBatches.size(); i++)
+    {
+        const StaticBatch &batch = staticBatches[i];
+        if (batch.mesh == nullptr || (cullingEnabled && !batch.bounds.overlaps(view)))
+        {
+            continue;
+        }
+        renderQueue.add(makeSortKey(batch.layer, batch.shader->id(), batch.mesh->meshKey(),
+                                    sortKeyMaterial(Vector4::one()), sortKeyDepth(batch.bounds.center().z, worldSize.z)),
+                        staticItemBit | i);
+    }
+    renderQueue.sort();
+}
+
+// Draws the queue in order. GLState drops the program, VAO and uniform
+// calls that repeat the previous item's, which the ordering makes common.
+inline void World::drawQueued()
+{
+    for (const RenderQueue::Item &item : renderQueue.getItems())
+    {
+        drawItem(item.index);
+    }
+}
+
+inline void World::drawItem(uint32_t item)
+{
+    if (item & staticItemBit)
+    {
+        Shape *mesh = staticBatches[item & ~staticItemBit].mesh;
+        mesh->shader->use();
+        if (!mesh->uploaded())
+        {
+            mesh->init();
+        }
+        mesh->drawPooled(); // batch meshes aren't bound, so not through draw()
+        return;
+    }
+    Shape *shape = shapes[item].shape;
+    shape->shader->use();
+    shape->draw();
+}
+
+// Queues every visible pooled shape drawn with the replaced program as an
+// indirect command; anything else is drawn normally at its place in the
+// queue. Groups are broken at each layer change so layers keep their order.
+inline void World::drawIndirect()
+{
+    size_t external = 0;
+    indirect.begin();
+    uint64_t layer = ~0ull;
+    for (const RenderQueue::Item &item : renderQueue.getItems())
+    {
+        if (item.key >> 56 != layer) // see makeSortKey()
+        {
+            indirect.breakGroups();
+            layer = item.key >> 56;
+        }
+        Shape *shape = item.index & staticItemBit ? staticBatches[item.index & ~staticItemBit].mesh
+                                                  : shapes[item.index].shape;
+        if (!shape->usesPool() || shape->shader != indirectReplaces)
+        {
+            indirect.addExternal(item.index);
+            external++;
+            continue;
+        }
+        queueIndirect(shape);
+    }
+    indirect.submit([this](uint32_t item)
+                    { drawItem(item); });
+    lastDrawCalls = indirect.getLastCallCount() + external;
+}
+
+inline void World::queueIndirect(Shape *shape)
+{
+    GeometryPool &pool = GeometryPool::getInstance();
+    if (!shape->uploaded())
+    {
+        shape->init();
+    }
+    if (shape->vertices.empty())
+    {
+        return;
+    }
+    uint32_t draw = indirect.getProgram()->takesModel2D() ? indirect.addDraw(shape->getModel2D(), shape->color)
+                                                          : indirect.addDraw(shape->getModel(), shape->color);
+    if (shape->isIndexed())
+    {
+        indirect.addElements(shape->uploadedFormat, shape->indexType, (uint32_t)shape->indices.size(),
+                             pool.byteOffsetOf(shape->poolIndices), (int32_t)pool.offsetOf(shape->poolVertices), draw);
+    }
+    else
+    {
+        indirect.addArrays(shape->uploadedFormat, (uint32_t)shape->vertices.size(), pool.offsetOf(shape->poolVertices), draw);
+    }
+}
+
+inline World::~World()
+{
+    for (StaticBatch &batch : staticBatches)
+    {
+        delete batch.mesh;
+    }
+}
+
+inline bool World::setStatic(Shape *shape, bool isStatic)
+{
+    if (!isBound(shape) || (isStatic && !shape->isBatchable()))
+    {
+        return false;
+    }
+    if (isStatic && shape->staticBatch < 0)
+    {
+        addToStaticBatch(shape);
+    }
+    else if (!isStatic && shape->staticBatch >= 0)
+    {
+        removeFromStaticBatch(shape);
+    }
+    return true;
+}
+
+inline void World::setStaticCellSize(float size)
+{
+    staticCellSize = size;
+    std::vector<ShapeHandle> members;
+    for (StaticBatch &batch : staticBatches)
+    {
+        members.insert(members.end(), batch.members.begin(), batch.members.end());
+        batch.members.clear();
+        batch.dirty = true;
+    }
+    for (ShapeHandle handle : members)
+    {
+        Shape *shape = getShape(handle);
+        shape->staticBatch = -1;
+        addToStaticBatch(shape);
+    }
+}
+
+// Files the shape under the cell its bounds' center falls in
+inline void World::addToStaticBatch(Shape *shape)
+{
+    Vector3 center = shape->getBounds().isEmpty() ? shape->position : shape->getBounds().center();
+    std::tuple<int, int, GLuint, int> key((int)std::floor(center.x / staticCellSize), (int)std::floor(center.y / staticCellSize),
+                                          shape->shader->id(), shape->layer);
+    auto found = staticBatchLookup.find(key);
+    uint32_t index;
+    if (found != staticBatchLookup.end())
+    {
+        index = found->second;
+    }
+    else
+    {
+        index = (uint32_t)staticBatches.size();
+        StaticBatch batch;
+        batch.key = key;
+        batch.shader = shape->shader;
+        batch.layer = shape->layer;
+        staticBatches.push_back(batch);
+        staticBatchLookup[key] = index;
+    }
+    staticBatches[index].members.push_back(shape->handle);
+    staticBatches[index].dirty = true;
+    shape->staticBatch = (int)index;
+}
+
+inline void World::removeFromStaticBatch(Shape *shape)
+{
+    StaticBatch &batch = staticBatches[shape->staticBatch];
+    auto it = std::find(batch.members.begin(), batch.members.end(), shape->handle);
+    if (it != batch.members.end())
+    {
+        *it = batch.members.back();
+        batch.members.pop_back();
+    }
+    batch.dirty = true;
+    shape->staticBatch = -1;
+}
+
+// Refiles the shape (its cell or layer may have changed) and marks the
+// batches involved for re-merging
+inline void World::staticShapeChanged(Shape *shape)
+{
+    if (!isBound(shape))
+    {
+        return;
+    }
+    removeFromStaticBatch(shape);
+    addToStaticBatch(shape);
+}
+
+// Re-merges every batch whose membership or members changed. Members
+// keep their order in the batch, so the merge is deterministic.
+inline void World::rebuildStaticBatches()
+{
+    for (StaticBatch &batch : staticBatches)
+    {
+        if (!batch.dirty)
+        {
+            continue;
+        }
+        batch.dirty = false;
+        if (batch.members.empty())
+        {
+            delete batch.mesh; // its pool ranges go back to the GeometryPool
+            batch.mesh = nullptr;
+            batch.bounds = AABB();
+            continue;
+        }
+
+        mergeParts.clear();
+        for (ShapeHandle handle : batch.members)
+        {
+            const Shape *shape = getShape(handle);
+            MeshPart part;
+            part.vertices = shape->vertices.data();
+            part.vertexCount = shape->vertices.size();
+            part.vertexColors = shape->hasVertexColors() ? shape->vertexColors.data() : nullptr;
+            part.indices = shape->indices.data();
+            part.indexCount = shape->indices.size();
+            part.model = shape->getModel(); // resolved here, the merge may run on other threads
+            part.color = shape->color;
+            mergeParts.push_back(part);
+        }
+        mergeMeshes(mergeParts, merged);
+
+        if (batch.mesh == nullptr)
+        {
+            batch.mesh = new Shape(nullptr, batch.shader);
+            batch.mesh->color = Vector4::one(); // colors are baked into the vertices
+            batch.mesh->setUsage(BufferUsage::Static);
+        }
+        Shape *mesh = batch.mesh;
+        mesh->vertices.swap(merged.vertices);
+        mesh->countRaisedVertices();
+        mesh->vertexColors.swap(merged.colors);
+        mesh->indices.swap(merged.indices);
+        mesh->localBounds = merged.bounds;
+        mesh->localBoundsDirty = false;
+        mesh->dirtyRanges.clear();
+        if (!mesh->vertices.empty())
+        {
+            mesh->markDirty(0, mesh->vertices.size());
+        }
+        mesh->indicesDirty = true;
+        mesh->invalidateBounds();
+        batch.bounds = merged.bounds;
+    }
+}
+
+inline void World::queueBoundsUpdate(Shape *shape)
+{
+    shape->boundsQueued = true;
+    boundsQueue.push_back(shape->handle);
+}
+
+inline void World::syncBounds()
+{
+    for (ShapeHandle handle : boundsQueue)
+    {
+        BoundShape *bound = shapes.get(handle);
+        if (bound)
+        {
+            bound->shape->boundsQueued = false;
+            broadPhase.update(handle.index, bound->shape->getBounds());
+            updateTreeLeaf(handle.index, bound->shape->getBounds());
+            setCullBounds(shapes.denseIndex(handle), bound->shape->getBounds());
+            if (bound->shape->staticBatch >= 0)
+            {
+                staticShapeChanged(bound->shape);
+            }
+        }
+    }
+    boundsQueue.clear();
+}
+
+inline void World::updateTreeLeaf(uint32_t slot, const AABB &bounds)
+{
+    int &leaf = treeLeaves[slot];
+    if (bounds.isEmpty())
+    {
+        if (leaf != AABBTree::nullNode)
+        {
+            shapeTree.remove(leaf);
+            leaf = AABBTree::nullNode;
+        }
+    }
+    else if (leaf == AABBTree::nullNode)
+    {
+        leaf = shapeTree.insert(slot, bounds);
+    }
+    else
+    {
+        shapeTree.move(leaf, bounds);
+    }
+}
+
+// Maps NDC xy back to the world plane z = 0: the inverse of the xy part
+// of a projection * view matrix
+inline Mat3x2 ndcToWorld(const Mat4 &vp)
+{
+    Mat3x2 inv;
+    Mat3x2::fromMat4(vp).inverse(inv);
+    return inv;
+}
+
+inline Vector2 World::screenToWorld(GLFWwindow *window, const Vector2 &screen) const
+{
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    float ndcX = 2.0f * screen.x / width - 1.0f;
+    float ndcY = 1.0f - 2.0f * screen.y / height;
+
+    return ndcToWorld(computeViewProjection()).transformPoint(Vector2(ndcX, ndcY));
+}
+
+inline AABB World::getViewBounds() const
+{
+    Mat3x2 toWorld = ndcToWorld(computeViewProjection());
+    AABB view;
+    for (int corner = 0; corner < 4; corner++)
+    {
+        Vector2 p = toWorld.transformPoint(Vector2(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f));
+        view.expand(Vector3(p.x, p.y, 0.0f));
+    }
+    return view;
+}
+
+inline size_t World::queryRect(const AABB &rect, Shape **out, size_t capacity)
+{
+    syncBounds();
+    size_t count = 0;
+    if (capacity > 0)
+    {
+        shapeTree.queryRect(rect, [&](uint32_t slot)
+                            {
+                                out[count++] = slotShapes[slot];
+                                return count < capacity; });
+    }
+    return count;
+}
+
+inline size_t World::queryPoint(const Vector2 &p, Shape **out, size_t capacity)
+{
+    Vector3 point(p.x, p.y, 0.0f);
+    return queryRect(AABB(point, point), out, capacity);
+}
+
+inline size_t World::raycast(const Vector2 &origin, const Vector2 &dir, float maxDistance,
+                             Shape **out, float *distances, size_t capacity)
+{
+    syncBounds();
+    size_t count = 0;
+    if (capacity > 0)
+    {
+        Vector2 unit = dir.normalized(); // so distances come out in world units
+        shapeTree.raycast(Vector3(origin.x, origin.y, 0.0f), Vector3(unit.x, unit.y, 0.0f), maxDistance,
+                          [&](uint32_t slot, float t)
+                          {
+                              if (distances)
+                                  distances[count] = t;
+                              out[count++] = slotShapes[slot];
+                              return count < capacity; });
+    }
+    return count;
+}
+
+inline size_t World::nearestShapes(const Vector2 &p, size_t k, Shape **out, float *distancesSq)
+{
+    syncBounds();
+    return shapeTree.nearest(Vector3(p.x, p.y, 0.0f), k, out, distancesSq, [&](uint32_t slot)
+                             { return slotShapes[slot]; });
+}
+
+inline Shape *World::pickShape(GLFWwindow *window)
+{
+    syncBounds();
+    Vector2 p = screenToWorld(window, getMousePos(window));
+    Vector3 point(p.x, p.y, 0.0f);
+    Shape *best = nullptr;
+    float bestArea = 0.0f;
+    shapeTree.queryRect(AABB(point, point), [&](uint32_t slot)
+                        {
+                            const AABB &b = slotShapes[slot]->getBounds();
+                            float area = (b.max.x - b.min.x) * (b.max.y - b.min.y);
+                            if (!best || area < bestArea)
+                            {
+                                best = slotShapes[slot];
+                                bestArea = area;
+                            }
+                            return true; });
+    return best;
+}
+
+inline void World::updateCollisions()
+{
+    syncBounds();
+    pairScratch.clear();
+    broadPhase.findPairs(pairScratch);
+    overlappingPairs.clear();
+    for (const auto &pair : pairScratch)
+    {
+        overlappingPairs.push_back(ShapePair(slotShapes[pair.first], slotShapes[pair.second]));
+    }
+}
+
+// Strict overlap on x and y; touching edges don't count as contact
+inline bool penetrates2D(const AABB &a, const AABB &b)
+{
+    return a.min.x < b.max.x && a.max.x > b.min.x &&
+           a.min.y < b.max.y && a.max.y > b.min.y;
+}
+
+// Shortens delta along `axis` (0 = x, 1 = y) so `box` stops at the first
+// candidate it would run into. Candidates already overlapping the box on
+// that axis are ignored so shapes can always move out of an overlap.
+inline void World::clipAxis(const AABB &box, Vector3 &delta, int axis)
+{
+    float d = axis == 0 ? delta.x : delta.y;
+    if (d == 0.0f)
+    {
+        return;
+    }
+    int other = 1 - axis;
+    float boxMin[2] = {box.min.x, box.min.y};
+    float boxMax[2] = {box.max.x, box.max.y};
+
+    for (uint32_t id : collisionCandidates)
     {
-        shape->draw();
+        const AABB &o = broadPhase.getBounds(id);
+        float oMin[2] = {o.min.x, o.min.y};
+        float oMax[2] = {o.max.x, o.max.y};
+        if (!(boxMin[other] < oMax[other] && boxMax[other] > oMin[other]))
+        {
+            continue; // no overlap on the other axis, can't collide
+        }
+        if (d > 0.0f && boxMax[axis] <= oMin[axis])
+        {
+            d = std::min(d, oMin[axis] - boxMax[axis]);
+        }
+        else if (d < 0.0f && boxMin[axis] >= oMax[axis])
+        {
+            d = std::max(d, oMax[axis] - boxMin[axis]);
+        }
     }
+
+    if (axis == 0)
+        delta.x = d;
+    else
+        delta.y = d;
 }
 
-inline bool World::translateCallback(Shape *shape, const Vector3 &delta)
+inline bool World::translateCallback(Shape *shape, Vector3 &delta)
 {
+    AABB box = shape->getBounds();
+    AABB moved = box.translated(delta);
+
+    if (moved.min.x < 0 || moved.max.x > worldSize.x ||
+        moved.min.y < 0 || moved.max.y > worldSize.y)
+    {
+        return false; // Block movement
+    }
 
-    for (const auto &v : shape->getVertices())
+    if (collisionResponse == CollisionResponse::None)
     {
-        Vector3 newPos = v + delta;
+        return true; // Allow movement
+    }
 
-        if (newPos.x < 0 || newPos.x > worldSize.x ||
-            newPos.y < 0 || newPos.y > worldSize.y)
+    // Only shapes the swept box reaches can be hit
+    syncBounds();
+    AABB swept = box;
+    swept.merge(moved);
+    uint32_t self = shape->handle.index;
+    collisionCandidates.clear();
+    broadPhase.query(swept, [&](uint32_t id)
+                     {
+                         if (id != self)
+                         {
+                             collisionCandidates.push_back(id);
+                         } });
+
+    if (collisionResponse == CollisionResponse::Block)
+    {
+        for (uint32_t id : collisionCandidates)
         {
-            return false; // Block movement
+            const AABB &o = broadPhase.getBounds(id);
+            if (penetrates2D(moved, o) && !penetrates2D(box, o))
+            {
+                return false; // Block movement
+            }
         }
+        return true;
     }
 
-    return true; // Allow movement
+    clipAxis(box, delta, 0);
+    box = box.translated(Vector3(delta.x, 0.0f, 0.0f));
+    clipAxis(box, delta, 1);
+    return true; // Allow the (possibly shortened) movement
 }
 
 #endif
\ No newline at end of file
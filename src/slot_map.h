@@ -0,0 +1,138 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Generational reference into a SlotMap. A handle goes stale once its
+// element is erased, even if the slot is later reused.
+struct SlotHandle
+{
+    static constexpr uint32_t npos = 0xFFFFFFFFu;
+
+    uint32_t index = npos;
+    uint32_t generation = 0;
+
+    bool operator==(const SlotHandle &o) const { return index == o.index && generation == o.generation; }
+    bool operator!=(const SlotHandle &o) const { return !(*this == o); }
+};
+
+// Values live contiguously in insertion order (modulo swap-removes) for
+// fast iteration; handles map to them through a slot table. insert, erase,
+// contains and get are all O(1).
+template <typename T>
+class SlotMap
+{
+private:
+    struct Slot
+    {
+        uint32_t dense;      // index into values while occupied, next free slot otherwise
+        uint32_t generation; // bumped on erase so older handles go stale
+    };
+
+    std::vector<Slot> slots;
+    std::vector<T> values;
+    std::vector<uint32_t> denseToSlot;
+    uint32_t freeHead = SlotHandle::npos;
+
+public:
+    SlotHandle insert(const T &value)
+    {
+        uint32_t slotIndex;
+        if (freeHead != SlotHandle::npos)
+        {
+            slotIndex = freeHead;
+            freeHead = slots[slotIndex].dense;
+        }
+        else
+        {
+            slotIndex = (uint32_t)slots.size();
+            slots.push_back({0, 1});
+        }
+
+        slots[slotIndex].dense = (uint32_t)values.size();
+        values.push_back(value);
+        denseToSlot.push_back(slotIndex);
+
+        SlotHandle handle;
+        handle.index = slotIndex;
+        handle.generation = slots[slotIndex].generation;
+        return handle;
+    }
+
+    bool contains(SlotHandle handle) const
+    {
+        return handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+    }
+
+    T *get(SlotHandle handle)
+    {
+        return contains(handle) ? &values[slots[handle.index].dense] : nullptr;
+    }
+
+    const T *get(SlotHandle handle) const
+    {
+        return contains(handle) ? &values[slots[handle.index].dense] : nullptr;
+    }
+
+    // Position of the element in the dense array, npos for stale handles
+    uint32_t denseIndex(SlotHandle handle) const
+    {
+        return contains(handle) ? slots[handle.index].dense : SlotHandle::npos;
+    }
+
+    SlotHandle handleAt(size_t dense) const
+    {
+        SlotHandle handle;
+        handle.index = denseToSlot[dense];
+        handle.generation = slots[handle.index].generation;
+        return handle;
+    }
+
+    // Swap-removes the element; the last element takes its dense position
+    bool erase(SlotHandle handle)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+
+        uint32_t dense = slots[handle.index].dense;
+        uint32_t last = (uint32_t)values.size() - 1;
+        if (dense != last)
+        {
+            values[dense] = std::move(values[last]);
+            denseToSlot[dense] = denseToSlot[last];
+            slots[denseToSlot[dense]].dense = dense;
+        }
+        values.pop_back();
+        denseToSlot.pop_back();
+
+        slots[handle.index].generation++;
+        slots[handle.index].dense = freeHead;
+        freeHead = handle.index;
+        return true;
+    }
+
+    void clear()
+    {
+        while (!values.empty())
+        {
+            erase(handleAt(values.size() - 1));
+        }
+    }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+
+    T &operator[](size_t dense) { return values[dense]; }
+    const T &operator[](size_t dense) const { return values[dense]; }
+
+    typename std::vector<T>::iterator begin() { return values.begin(); }
+    typename std::vector<T>::iterator end() { return values.end(); }
+    typename std::vector<T>::const_iterator begin() const { return values.begin(); }
+    typename std::vector<T>::const_iterator end() const { return values.end(); }
+};
+
+#endif
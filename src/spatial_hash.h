@@ -0,0 +1,247 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "bounds.h"
+
+// Uniform-grid broad phase over the xy plane. Objects are identified by a
+// small integer id (the World uses the shape's slot index) and stored in
+// every cell their box touches. Moving an object only edits the cells it
+// entered or left.
+class SpatialHash
+{
+private:
+    struct CellRange
+    {
+        int minX, minY, maxX, maxY;
+
+        bool empty() const { return minX > maxX; }
+        bool contains(int x, int y) const { return x >= minX && x <= maxX && y >= minY && y <= maxY; }
+    };
+
+    struct Entry
+    {
+        AABB bounds;
+        CellRange cells = {0, 0, -1, -1};
+        bool active = false;
+    };
+
+    float cellSize;
+    std::vector<Entry> entries; // indexed by id
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+
+    std::vector<uint32_t> visitStamp; // per id, dedups objects spanning several cells
+    uint32_t currentStamp = 0;
+
+    static uint64_t key(int x, int y)
+    {
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+    }
+
+    int cellCoord(float v) const
+    {
+        return (int)std::floor(v / cellSize);
+    }
+
+    CellRange rangeOf(const AABB &box) const
+    {
+        if (box.isEmpty())
+        {
+            return {0, 0, -1, -1};
+        }
+        return {cellCoord(box.min.x), cellCoord(box.min.y), cellCoord(box.max.x), cellCoord(box.max.y)};
+    }
+
+    void addToCell(int x, int y, uint32_t id)
+    {
+        cells[key(x, y)].push_back(id);
+    }
+
+    void removeFromCell(int x, int y, uint32_t id)
+    {
+        auto it = cells.find(key(x, y));
+        if (it == cells.end())
+        {
+            return;
+        }
+        std::vector<uint32_t> &ids = it->second;
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            if (ids[i] == id)
+            {
+                ids[i] = ids.back();
+                ids.pop_back();
+                break;
+            }
+        }
+        if (ids.empty())
+        {
+            cells.erase(it);
+        }
+    }
+
+    uint32_t nextStamp()
+    {
+        if (++currentStamp == 0) // wrapped, old stamps could collide
+        {
+            std::fill(visitStamp.begin(), visitStamp.end(), 0);
+            currentStamp = 1;
+        }
+        return currentStamp;
+    }
+
+public:
+    explicit SpatialHash(float cellSize = 8.0f) : cellSize(cellSize) {}
+
+    float getCellSize() const
+    {
+        return cellSize;
+    }
+
+    // Changes the grid resolution and re-buckets everything
+    void setCellSize(float size)
+    {
+        cellSize = size;
+        cells.clear();
+        for (uint32_t id = 0; id < entries.size(); id++)
+        {
+            Entry &e = entries[id];
+            if (!e.active)
+            {
+                continue;
+            }
+            e.cells = rangeOf(e.bounds);
+            for (int x = e.cells.minX; x <= e.cells.maxX; x++)
+                for (int y = e.cells.minY; y <= e.cells.maxY; y++)
+                    addToCell(x, y, id);
+        }
+    }
+
+    void insert(uint32_t id, const AABB &box)
+    {
+        if (id >= entries.size())
+        {
+            entries.resize(id + 1);
+            visitStamp.resize(id + 1, 0);
+        }
+        if (entries[id].active)
+        {
+            update(id, box);
+            return;
+        }
+        Entry &e = entries[id];
+        e.active = true;
+        e.bounds = box;
+        e.cells = rangeOf(box);
+        for (int x = e.cells.minX; x <= e.cells.maxX; x++)
+            for (int y = e.cells.minY; y <= e.cells.maxY; y++)
+                addToCell(x, y, id);
+    }
+
+    void update(uint32_t id, const AABB &box)
+    {
+        if (id >= entries.size() || !entries[id].active)
+        {
+            insert(id, box);
+            return;
+        }
+        Entry &e = entries[id];
+        CellRange oldCells = e.cells;
+        CellRange newCells = rangeOf(box);
+        e.bounds = box;
+        e.cells = newCells;
+
+        for (int x = oldCells.minX; x <= oldCells.maxX; x++)
+            for (int y = oldCells.minY; y <= oldCells.maxY; y++)
+                if (!newCells.contains(x, y))
+                    removeFromCell(x, y, id);
+
+        for (int x = newCells.minX; x <= newCells.maxX; x++)
+            for (int y = newCells.minY; y <= newCells.maxY; y++)
+                if (!oldCells.contains(x, y))
+                    addToCell(x, y, id);
+    }
+
+    void remove(uint32_t id)
+    {
+        if (id >= entries.size() || !entries[id].active)
+        {
+            return;
+        }
+        Entry &e = entries[id];
+        for (int x = e.cells.minX; x <= e.cells.maxX; x++)
+            for (int y = e.cells.minY; y <= e.cells.maxY; y++)
+                removeFromCell(x, y, id);
+        e = Entry();
+    }
+
+    const AABB &getBounds(uint32_t id) const
+    {
+        return entries[id].bounds;
+    }
+
+    // Calls visit(id) once for every object whose box overlaps `box`
+    template <typename Visitor>
+    void query(const AABB &box, Visitor &&visit)
+    {
+        CellRange range = rangeOf(box);
+        uint32_t stamp = nextStamp();
+        for (int x = range.minX; x <= range.maxX; x++)
+        {
+            for (int y = range.minY; y <= range.maxY; y++)
+            {
+                auto it = cells.find(key(x, y));
+                if (it == cells.end())
+                {
+                    continue;
+                }
+                for (uint32_t id : it->second)
+                {
+                    if (visitStamp[id] != stamp && entries[id].bounds.overlaps(box))
+                    {
+                        visitStamp[id] = stamp;
+                        visit(id);
+                    }
+                }
+            }
+        }
+    }
+
+    // Appends every overlapping pair (lower id first). A pair sharing
+    // several cells is reported only from the first cell of the overlap
+    // (lowest x, then y), so no dedup set is needed.
+    void findPairs(std::vector<std::pair<uint32_t, uint32_t>> &out) const
+    {
+        for (const auto &cell : cells)
+        {
+            int cx = (int)(int32_t)(cell.first >> 32);
+            int cy = (int)(int32_t)(uint32_t)cell.first;
+            const std::vector<uint32_t> &ids = cell.second;
+            for (size_t i = 0; i < ids.size(); i++)
+            {
+                const Entry &a = entries[ids[i]];
+                for (size_t j = i + 1; j < ids.size(); j++)
+                {
+                    const Entry &b = entries[ids[j]];
+                    if (std::max(a.cells.minX, b.cells.minX) != cx ||
+                        std::max(a.cells.minY, b.cells.minY) != cy)
+                    {
+                        continue;
+                    }
+                    if (a.bounds.overlaps(b.bounds))
+                    {
+                        uint32_t lo = std::min(ids[i], ids[j]);
+                        uint32_t hi = std::max(ids[i], ids[j]);
+                        out.push_back(std::make_pair(lo, hi));
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif
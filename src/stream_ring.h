@@ -0,0 +1,234 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "geometry_pool.h"
+
+// Upload space for geometry rewritten every frame (needs GL 4.4).
+//
+// One buffer with immutable storage is mapped persistently and split
+// into three frame regions. Each frame writes into the next region with
+// a bump allocator, so the CPU never writes memory a draw in flight may
+// still read, and nothing is reallocated. A fence at the end of each
+// frame guards its region; beginFrame() only has to wait when the GPU is
+// three whole frames behind.
+//
+// Vertices and indices share the buffer: it is bound as both the vertex
+// and the element array buffer of one VAO per vertex format. Draws use
+// a base vertex and an index byte offset, like GeometryPool ranges.
+//
+// A frame that runs out of space hands out nullptr for the rest of the
+// frame (callers fall back to their own buffers). The next beginFrame()
+// then replaces the buffer with one big enough.
+class StreamRing
+{
+private:
+    static constexpr size_t regionCount = 3;
+    static constexpr size_t initialRegionBytes = 1 << 20;
+
+    GpuBuffer buffer;
+    uint8_t *mapped = nullptr;
+    size_t regionBytes = initialRegionBytes;
+    GLsync fences[regionCount] = {};
+    size_t region = 0;
+    size_t head = 0;      // bytes used in the current region
+    size_t requested = 0; // bytes the current frame asked for, fitting or not
+    bool wanted = false;  // something asked for space; create the buffer next frame
+    bool enabled = true;
+    uint64_t frame = 0;
+
+    static constexpr size_t formatCount = vertexFormatCount;
+    VertexArray vertexArrays[formatCount];
+    bool layoutSpecified[formatCount] = {};
+
+    size_t stalls = 0;
+    size_t bytesWritten = 0;
+
+    StreamRing()
+    {
+        GpuResources::getInstance(); // constructed first so it outlives the buffer at exit
+    }
+
+    // Blocks until the region's last frame is done on the GPU
+    void waitRegion(size_t r)
+    {
+        if (fences[r] == nullptr)
+        {
+            return;
+        }
+        GLenum result = glClientWaitSync(fences[r], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            stalls++;
+            while (result == GL_TIMEOUT_EXPIRED)
+            {
+                result = glClientWaitSync(fences[r], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            }
+        }
+        glDeleteSync(fences[r]);
+        fences[r] = nullptr;
+    }
+
+    void create(size_t bytesPerRegion)
+    {
+        regionBytes = bytesPerRegion;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffer.setStorage(regionBytes * regionCount, flags);
+        mapped = static_cast<uint8_t *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, regionBytes * regionCount, flags));
+        for (bool &specified : layoutSpecified)
+        {
+            specified = false; // new buffer name
+        }
+    }
+
+    void destroy()
+    {
+        for (size_t r = 0; r < regionCount; r++)
+        {
+            waitRegion(r);
+        }
+        if (mapped != nullptr)
+        {
+            buffer.bind();
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            mapped = nullptr;
+        }
+        buffer.release();
+    }
+
+public:
+    StreamRing(const StreamRing &) = delete;
+    StreamRing &operator=(const StreamRing &) = delete;
+
+    static StreamRing &getInstance()
+    {
+        static StreamRing instance;
+        return instance;
+    }
+
+    static bool supported()
+    {
+        return GLAD_GL_VERSION_4_4 != 0;
+    }
+
+    // When off (or unsupported) streamed shapes orphan their own buffers
+    void setEnabled(bool on)
+    {
+        enabled = on;
+    }
+
+    bool isEnabled() const
+    {
+        return enabled && supported();
+    }
+
+    // Moves to the next region, waiting for the GPU if it still reads it.
+    // Also (re)creates the buffer when the last frame needed more space.
+    void beginFrame()
+    {
+        if (!isEnabled() || (!wanted && mapped == nullptr))
+        {
+            return;
+        }
+        frame++;
+        if (mapped == nullptr || requested > regionBytes)
+        {
+            size_t bytes = std::max(regionBytes, initialRegionBytes);
+            while (bytes < requested)
+            {
+                bytes *= 2;
+            }
+            destroy();
+            create(bytes);
+            region = 0;
+        }
+        else
+        {
+            region = (region + 1) % regionCount;
+            waitRegion(region);
+        }
+        head = 0;
+        requested = 0;
+    }
+
+    // Fences off everything written into the region this frame
+    void endFrame()
+    {
+        if (mapped == nullptr || head == 0)
+        {
+            return;
+        }
+        if (fences[region] != nullptr)
+        {
+            glDeleteSync(fences[region]);
+        }
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // Reserves `bytes` at a multiple of `alignment` (any value, e.g. the
+    // vertex stride) in this frame's region. Returns where to write and
+    // sets `byteOffset` to the position in the buffer, or returns nullptr
+    // when the region is full or the ring isn't running yet.
+    uint8_t *allocate(size_t bytes, size_t alignment, size_t &byteOffset)
+    {
+        wanted = true;
+        size_t start = region * regionBytes;
+        size_t offset = (start + head + alignment - 1) / alignment * alignment;
+        requested = std::max(requested, offset - start + bytes);
+        if (mapped == nullptr || offset - start + bytes > regionBytes)
+        {
+            return nullptr;
+        }
+        head = offset - start + bytes;
+        byteOffset = offset;
+        bytesWritten += bytes;
+        return mapped + offset;
+    }
+
+    // Binds the format's VAO, sourcing vertices and indices from the ring
+    void bind(VertexFormat format)
+    {
+        size_t f = (size_t)format;
+        VertexArray &vao = vertexArrays[f];
+        bool created = vao.create();
+        vao.bind();
+        if (created || !layoutSpecified[f])
+        {
+            GLState &state = GLState::getInstance();
+            state.bindBuffer(GL_ARRAY_BUFFER, buffer.id());
+            specifyVertexFormat(format);
+            state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id());
+            layoutSpecified[f] = true;
+        }
+    }
+
+    GLuint vertexArrayOf(VertexFormat format) const
+    {
+        return vertexArrays[(size_t)format].id();
+    }
+
+    // Frames started since the ring was first used; space handed out is
+    // only valid during the frame it was allocated in
+    uint64_t getFrame() const { return frame; }
+    size_t getRegionBytes() const { return regionBytes; }
+    size_t getStallCount() const { return stalls; } // beginFrame() calls that had to wait
+    size_t getBytesWritten() const { return bytesWritten; }
+
+    // Call before the context goes away
+    void shutdown()
+    {
+        destroy();
+        for (VertexArray &vao : vertexArrays)
+        {
+            vao.release();
+        }
+        wanted = false;
+    }
+};
+
+#endif
@@ -3,16 +3,46 @@
 #define VECTOR_H
 
 #include <cmath>
+#include <cstddef>
 #include <iostream>
 #include <cstring>
+#include <type_traits>
+#include "mat4_kernels.h"
+
+// `v * s` for Vector2/3/4, kept unevaluated so that `a + v * s` and
+// `a - v * s` are computed in one pass without the scaled temporary. It
+// holds a copy of v, so storing one with `auto` is safe, and it converts
+// to V wherever a vector is expected.
+template <typename V>
+struct ScaledVector
+{
+    V v;
+    float s;
+
+    constexpr operator V() const { return v.scaled(s); }
+};
+
+// `a + v * s` and `a - v * s` are friends of each vector class; the rest
+// go through them or through V
+template <typename V>
+constexpr V operator+(const ScaledVector<V> &a, const V &b) { return b + a; }
+template <typename V>
+constexpr V operator-(const ScaledVector<V> &a, const V &b) { return V(a) - b; }
+template <typename V>
+constexpr V operator+(const ScaledVector<V> &a, const ScaledVector<V> &b) { return V(a) + b; }
+template <typename V>
+constexpr V operator-(const ScaledVector<V> &a, const ScaledVector<V> &b) { return V(a) - b; }
+template <typename V>
+constexpr ScaledVector<V> operator*(const ScaledVector<V> &a, float s) { return V(a) * s; }
+template <typename V>
+constexpr V operator/(const ScaledVector<V> &a, float s) { return V(a) / s; }
 
 class Vector2
 {
 public:
     float x;
     float y;
-    Vector2(float x = 0.0f, float y = 0.0f) : x(x), y(y) {}
-    ~Vector2() {}
+    constexpr Vector2(float x = 0.0f, float y = 0.0f) : x(x), y(y) {}
     float length() const { return std::sqrt(x * x + y * y); }
 
     void normalize()
@@ -25,12 +55,12 @@ public:
         }
     }
 
-    static Vector2 zero()
+    static constexpr Vector2 zero()
     {
         return Vector2(0.0f, 0.0f);
     }
 
-    static Vector2 one()
+    static constexpr Vector2 one()
     {
         return Vector2(1.0f, 1.0f);
     }
@@ -41,12 +71,28 @@ public:
         return (len > 0) ? Vector2(x / len, y / len) : Vector2(0, 0);
     }
 
-    float dot(const Vector2 &v) const { return x * v.x + y * v.y; }
+    constexpr float dot(const Vector2 &v) const { return x * v.x + y * v.y; }
+
+    constexpr Vector2 scaled(float s) const { return Vector2(x * s, y * s); }
 
-    Vector2 operator+(const Vector2 &v) const { return Vector2(x + v.x, y + v.y); }
-    Vector2 operator-(const Vector2 &v) const { return Vector2(x - v.x, y - v.y); }
-    Vector2 operator*(float s) const { return Vector2(x * s, y * s); }
-    Vector2 operator/(float s) const { return Vector2(x / s, y / s); }
+    constexpr Vector2 operator+(const Vector2 &v) const { return Vector2(x + v.x, y + v.y); }
+    constexpr Vector2 operator-(const Vector2 &v) const { return Vector2(x - v.x, y - v.y); }
+    constexpr ScaledVector<Vector2> operator*(float s) const { return {*this, s}; }
+    constexpr Vector2 operator/(float s) const { return Vector2(x / s, y / s); }
+
+    // a + v * s in one pass, see ScaledVector
+    friend constexpr Vector2 operator+(const Vector2 &a, const ScaledVector<Vector2> &v)
+    {
+        return Vector2(
+            a.x + v.v.x * v.s,
+            a.y + v.v.y * v.s);
+    }
+    friend constexpr Vector2 operator-(const Vector2 &a, const ScaledVector<Vector2> &v)
+    {
+        return Vector2(
+            a.x - v.v.x * v.s,
+            a.y - v.v.y * v.s);
+    }
 
     Vector2 &operator+=(const Vector2 &v)
     {
@@ -70,8 +116,7 @@ public:
     float x;
     float y;
     float z;
-    Vector3(float x = 0.0f, float y = 0.0f, float z = 0.0f) : x(x), y(y), z(z) {}
-    ~Vector3() {}
+    constexpr Vector3(float x = 0.0f, float y = 0.0f, float z = 0.0f) : x(x), y(y), z(z) {}
 
     float length() const { return std::sqrt(x * x + y * y + z * z); }
 
@@ -86,12 +131,12 @@ public:
         }
     }
 
-    static Vector3 zero()
+    static constexpr Vector3 zero()
     {
         return Vector3(0.0f, 0.0f, 0.0f);
     }
 
-    static Vector3 one()
+    static constexpr Vector3 one()
     {
         return Vector3(1.0f, 1.0f, 1.0f);
     }
@@ -102,9 +147,11 @@ public:
         return (len > 0) ? Vector3(x / len, y / len, z / len) : Vector3(0, 0, 0);
     }
 
-    float dot(const Vector3 &v) const { return x * v.x + y * v.y + z * v.z; }
+    constexpr float dot(const Vector3 &v) const { return x * v.x + y * v.y + z * v.z; }
 
-    Vector3 cross(const Vector3 &v) const
+    constexpr Vector3 scaled(float s) const { return Vector3(x * s, y * s, z * s); }
+
+    constexpr Vector3 cross(const Vector3 &v) const
     {
         return Vector3(
             y * v.z - z * v.y,
@@ -112,10 +159,26 @@ public:
             x * v.y - y * v.x);
     }
 
-    Vector3 operator+(const Vector3 &v) const { return Vector3(x + v.x, y + v.y, z + v.z); }
-    Vector3 operator-(const Vector3 &v) const { return Vector3(x - v.x, y - v.y, z - v.z); }
-    Vector3 operator*(float s) const { return Vector3(x * s, y * s, z * s); }
-    Vector3 operator/(float s) const { return Vector3(x / s, y / s, z / s); }
+    constexpr Vector3 operator+(const Vector3 &v) const { return Vector3(x + v.x, y + v.y, z + v.z); }
+    constexpr Vector3 operator-(const Vector3 &v) const { return Vector3(x - v.x, y - v.y, z - v.z); }
+    constexpr ScaledVector<Vector3> operator*(float s) const { return {*this, s}; }
+    constexpr Vector3 operator/(float s) const { return Vector3(x / s, y / s, z / s); }
+
+    // a + v * s in one pass, see ScaledVector
+    friend constexpr Vector3 operator+(const Vector3 &a, const ScaledVector<Vector3> &v)
+    {
+        return Vector3(
+            a.x + v.v.x * v.s,
+            a.y + v.v.y * v.s,
+            a.z + v.v.z * v.s);
+    }
+    friend constexpr Vector3 operator-(const Vector3 &a, const ScaledVector<Vector3> &v)
+    {
+        return Vector3(
+            a.x - v.v.x * v.s,
+            a.y - v.v.y * v.s,
+            a.z - v.v.z * v.s);
+    }
 
     Vector3 &operator+=(const Vector3 &v)
     {
@@ -142,8 +205,7 @@ public:
     float y;
     float z;
     float w;
-    Vector4(float x = 0.0f, float y = 0.0f, float z = 0.0f, float w = 0.0f) : x(x), y(y), z(z), w(w) {}
-    ~Vector4() {}
+    constexpr Vector4(float x = 0.0f, float y = 0.0f, float z = 0.0f, float w = 0.0f) : x(x), y(y), z(z), w(w) {}
 
     float length() const { return std::sqrt(x * x + y * y + z * z + w * w); }
 
@@ -159,12 +221,12 @@ public:
         }
     }
 
-    static Vector4 zero()
+    static constexpr Vector4 zero()
     {
         return Vector4(0.0f, 0.0f, 0.0f, 0.0f);
     }
 
-    static Vector4 one()
+    static constexpr Vector4 one()
     {
         return Vector4(1.0f, 1.0f, 1.0f, 1.0f);
     }
@@ -175,12 +237,32 @@ public:
         return (len > 0) ? Vector4(x / len, y / len, z / len, w / len) : Vector4(0, 0, 0, 0);
     }
 
-    float dot(const Vector4 &v) const { return x * v.x + y * v.y + z * v.z + w * v.w; }
+    constexpr float dot(const Vector4 &v) const { return x * v.x + y * v.y + z * v.z + w * v.w; }
+
+    constexpr Vector4 scaled(float s) const { return Vector4(x * s, y * s, z * s, w * s); }
 
-    Vector4 operator+(const Vector4 &v) const { return Vector4(x + v.x, y + v.y, z + v.z, w + v.w); }
-    Vector4 operator-(const Vector4 &v) const { return Vector4(x - v.x, y - v.y, z - v.z, w - v.w); }
-    Vector4 operator*(float s) const { return Vector4(x * s, y * s, z * s, w * s); }
-    Vector4 operator/(float s) const { return Vector4(x / s, y / s, z / s, w / s); }
+    constexpr Vector4 operator+(const Vector4 &v) const { return Vector4(x + v.x, y + v.y, z + v.z, w + v.w); }
+    constexpr Vector4 operator-(const Vector4 &v) const { return Vector4(x - v.x, y - v.y, z - v.z, w - v.w); }
+    constexpr ScaledVector<Vector4> operator*(float s) const { return {*this, s}; }
+    constexpr Vector4 operator/(float s) const { return Vector4(x / s, y / s, z / s, w / s); }
+
+    // a + v * s in one pass, see ScaledVector
+    friend constexpr Vector4 operator+(const Vector4 &a, const ScaledVector<Vector4> &v)
+    {
+        return Vector4(
+            a.x + v.v.x * v.s,
+            a.y + v.v.y * v.s,
+            a.z + v.v.z * v.s,
+            a.w + v.v.w * v.s);
+    }
+    friend constexpr Vector4 operator-(const Vector4 &a, const ScaledVector<Vector4> &v)
+    {
+        return Vector4(
+            a.x - v.v.x * v.s,
+            a.y - v.v.y * v.s,
+            a.z - v.v.z * v.s,
+            a.w - v.v.w * v.s);
+    }
 
     Vector4 &operator+=(const Vector4 &v)
     {
@@ -202,28 +284,74 @@ public:
     void print() const { std::cout << "(" << x << ", " << y << ", " << z << ", " << w << ")"; }
 };
 
+// 16-byte aligned Vector3, padded to four floats, for SIMD loads that
+// must not run into the next element and for GPU layouts (std140/std430
+// vec3) that round a vec3 up to 16 bytes
+struct alignas(16) Vector3A
+{
+    float x;
+    float y;
+    float z;
+    float pad; // always 0
+
+    constexpr Vector3A(float x = 0.0f, float y = 0.0f, float z = 0.0f) : x(x), y(y), z(z), pad(0.0f) {}
+    constexpr Vector3A(const Vector3 &v) : x(v.x), y(v.y), z(v.z), pad(0.0f) {}
+    constexpr operator Vector3() const { return Vector3(x, y, z); }
+};
+
+// 16-byte aligned Vector4, e.g. for a vec4 in a GPU buffer
+struct alignas(16) Vector4A
+{
+    float x;
+    float y;
+    float z;
+    float w;
+
+    constexpr Vector4A(float x = 0.0f, float y = 0.0f, float z = 0.0f, float w = 0.0f) : x(x), y(y), z(z), w(w) {}
+    constexpr Vector4A(const Vector4 &v) : x(v.x), y(v.y), z(v.z), w(v.w) {}
+    constexpr operator Vector4() const { return Vector4(x, y, z, w); }
+};
+
+// The vector types are copied with memcpy, uploaded to GL as float
+// arrays and reinterpreted from mapped buffers, which needs all of this
+static_assert(std::is_trivially_copyable<Vector2>::value && std::is_standard_layout<Vector2>::value, "Vector2 layout");
+static_assert(std::is_trivially_copyable<Vector3>::value && std::is_standard_layout<Vector3>::value, "Vector3 layout");
+static_assert(std::is_trivially_copyable<Vector4>::value && std::is_standard_layout<Vector4>::value, "Vector4 layout");
+static_assert(std::is_trivially_copyable<Vector3A>::value && std::is_standard_layout<Vector3A>::value, "Vector3A layout");
+static_assert(std::is_trivially_copyable<Vector4A>::value && std::is_standard_layout<Vector4A>::value, "Vector4A layout");
+static_assert(sizeof(Vector2) == 2 * sizeof(float) && offsetof(Vector2, y) == sizeof(float), "Vector2 must be two packed floats");
+static_assert(sizeof(Vector3) == 3 * sizeof(float) && offsetof(Vector3, z) == 2 * sizeof(float), "Vector3 must be three packed floats");
+static_assert(sizeof(Vector4) == 4 * sizeof(float) && offsetof(Vector4, w) == 3 * sizeof(float), "Vector4 must be four packed floats");
+static_assert(sizeof(Vector3A) == 16 && alignof(Vector3A) == 16 && offsetof(Vector3A, z) == 2 * sizeof(float), "Vector3A must be 16 aligned bytes");
+static_assert(sizeof(Vector4A) == 16 && alignof(Vector4A) == 16 && offsetof(Vector4A, w) == 3 * sizeof(float), "Vector4A must be 16 aligned bytes");
+
 struct Mat4
 {
+private:
+    struct Uninitialized
+    {
+    };
+
+    // Leaves m undefined, for results a kernel writes in full
+    explicit Mat4(Uninitialized) {}
+
+public:
     float m[16];
 
-    Mat4()
-    {
-        loadIdentity();
-    }
+    constexpr Mat4() : m{1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f} {}
 
     void loadIdentity()
     {
-        memset(m, 0, sizeof(m));
-        m[0] = m[5] = m[10] = m[15] = 1.0f;
+        *this = Mat4();
     }
 
-    static Mat4 identity()
+    static constexpr Mat4 identity()
     {
         return Mat4();
     }
 
     // Translation matrix
-    static Mat4 translate(float x, float y, float z)
+    static constexpr Mat4 translate(float x, float y, float z)
     {
         Mat4 r;
         r.m[12] = x;
@@ -232,10 +360,9 @@ struct Mat4
         return r;
     }
 
-    static Mat4 ortho(float left, float right, float bottom, float top, float zNear, float zFar)
+    static constexpr Mat4 ortho(float left, float right, float bottom, float top, float zNear, float zFar)
     {
         Mat4 r;
-        r.loadIdentity();
         r.m[0] = 2.0f / (right - left);
         r.m[5] = 2.0f / (top - bottom);
         r.m[10] = -2.0f / (zFar - zNear);
@@ -245,49 +372,276 @@ struct Mat4
         return r;
     }
 
-    // Add this inside the Mat4 struct
-    static Mat4 perspective(float fovDegrees, float aspect, float zNear, float zFar)
+    // `focal` is 1 / tan(fovy / 2); taking it precomputed lets fixed
+    // projections be built at compile time (std::tan isn't constexpr)
+    static constexpr Mat4 perspectiveFocal(float focal, float aspect, float zNear, float zFar)
     {
         Mat4 r;
-        r.loadIdentity();
+        r.m[0] = focal / aspect;
+        r.m[5] = focal;
+        r.m[10] = (zFar + zNear) / (zNear - zFar);
+        r.m[11] = -1.0f;
+        r.m[14] = (2.0f * zFar * zNear) / (zNear - zFar);
+        r.m[15] = 0.0f;
+        return r;
+    }
 
+    static Mat4 perspective(float fovDegrees, float aspect, float zNear, float zFar)
+    {
         float fovRad = fovDegrees * 3.14159265359f / 180.0f;
-        float f = 1.0f / tan(fovRad / 2.0f);
+        return perspectiveFocal(1.0f / tan(fovRad / 2.0f), aspect, zNear, zFar);
+    }
 
-        r.m[0] = f / aspect;
-        r.m[1] = 0.0f;
-        r.m[2] = 0.0f;
-        r.m[3] = 0.0f;
+    // Scale matrix
+    static constexpr Mat4 scale(float x, float y, float z)
+    {
+        Mat4 r;
+        r.m[0] = x;
+        r.m[5] = y;
+        r.m[10] = z;
+        return r;
+    }
 
-        r.m[4] = 0.0f;
-        r.m[5] = f;
-        r.m[6] = 0.0f;
-        r.m[7] = 0.0f;
+    // Rotation about the z axis, counter-clockwise in radians
+    static Mat4 rotateZ(float radians)
+    {
+        Mat4 r;
+        float c = cos(radians);
+        float s = sin(radians);
+        r.m[0] = c;
+        r.m[1] = s;
+        r.m[4] = -s;
+        r.m[5] = c;
+        return r;
+    }
 
-        r.m[8] = 0.0f;
-        r.m[9] = 0.0f;
-        r.m[10] = (zFar + zNear) / (zNear - zFar);
-        r.m[11] = -1.0f;
+    // translate(t) * rotateZ(radians) * scale(s), built directly
+    static Mat4 compose(const Vector3 &t, float radians, const Vector3 &s)
+    {
+        Mat4 r;
+        float c = cos(radians);
+        float sn = sin(radians);
+        r.m[0] = c * s.x;
+        r.m[1] = sn * s.x;
+        r.m[4] = -sn * s.y;
+        r.m[5] = c * s.y;
+        r.m[10] = s.z;
+        r.m[12] = t.x;
+        r.m[13] = t.y;
+        r.m[14] = t.z;
+        return r;
+    }
 
-        r.m[12] = 0.0f;
-        r.m[13] = 0.0f;
-        r.m[14] = (2.0f * zFar * zNear) / (zNear - zFar);
-        r.m[15] = 0.0f;
+    // Storage is column-major (m[col * 4 + row]) to match OpenGL, so
+    // a * b applies b first when transforming a point. The arithmetic is
+    // in mat4_kernels.h.
+    Mat4 operator*(const Mat4 &o) const
+    {
+        Mat4 r{Uninitialized()};
+        mat4Kernels().multiply(m, o.m, r.m);
+        return r;
+    }
 
+    Vector4 operator*(const Vector4 &v) const
+    {
+        Vector4 r;
+        mat4Kernels().transform(m, &v.x, &r.x); // Vector4 is four packed floats
         return r;
     }
 
-    Mat4 operator*(const Mat4 &o) const
+    Mat4 transposed() const
+    {
+        Mat4 r{Uninitialized()};
+        mat4Kernels().transpose(m, r.m);
+        return r;
+    }
+
+    // Sets `out` to the inverse; false (out untouched) when singular.
+    // `out` may be *this: the kernels write a temporary, since they
+    // must not alias their input.
+    bool inverse(Mat4 &out) const
+    {
+        Mat4 r{Uninitialized()};
+        if (!mat4Kernels().inverse(m, r.m))
+        {
+            return false;
+        }
+        out = r;
+        return true;
+    }
+
+    // Faster inverse for matrices whose bottom row is 0 0 0 1, such as
+    // any product of translate, rotate and scale
+    bool affineInverse(Mat4 &out) const
+    {
+        Mat4 r{Uninitialized()};
+        if (!mat4Kernels().affineInverse(m, r.m))
+        {
+            return false;
+        }
+        out = r;
+        return true;
+    }
+
+    constexpr Vector3 transformPoint(const Vector3 &p) const
+    {
+        return Vector3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                       m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                       m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]);
+    }
+
+    // True when the matrix only maps x and y (from x and y) and leaves z
+    // as it is, i.e. it is a Mat3x2 in disguise
+    constexpr bool isAffine2D() const
+    {
+        return m[2] == 0.0f && m[3] == 0.0f && m[6] == 0.0f && m[7] == 0.0f &&
+               m[8] == 0.0f && m[9] == 0.0f && m[10] == 1.0f && m[11] == 0.0f &&
+               m[14] == 0.0f && m[15] == 1.0f;
+    }
+};
+
+static_assert(std::is_trivially_copyable<Mat4>::value && sizeof(Mat4) == 16 * sizeof(float), "Mat4 must be 16 packed floats");
+
+// 2D affine transform: a 3x3 matrix whose bottom row is always 0 0 1, so
+// only the top two rows are stored. Column-major like Mat4
+// (m[col * 2 + row]): m[0..3] is the linear part and m[4], m[5] the
+// translation. A product costs 12 multiplies against 64 for Mat4.
+struct Mat3x2
+{
+    float m[6];
+
+    constexpr Mat3x2() : m{1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f} {}
+
+    static constexpr Mat3x2 identity()
+    {
+        return Mat3x2();
+    }
+
+    static constexpr Mat3x2 translate(float x, float y)
+    {
+        Mat3x2 r;
+        r.m[4] = x;
+        r.m[5] = y;
+        return r;
+    }
+
+    static constexpr Mat3x2 scale(float x, float y)
+    {
+        Mat3x2 r;
+        r.m[0] = x;
+        r.m[3] = y;
+        return r;
+    }
+
+    // Counter-clockwise in radians
+    static Mat3x2 rotate(float radians)
+    {
+        Mat3x2 r;
+        float c = cos(radians);
+        float s = sin(radians);
+        r.m[0] = c;
+        r.m[1] = s;
+        r.m[2] = -s;
+        r.m[3] = c;
+        return r;
+    }
+
+    // translate(t) * rotate(radians) * scale(s), built directly
+    static Mat3x2 compose(const Vector2 &t, float radians, const Vector2 &s)
+    {
+        Mat3x2 r;
+        float c = cos(radians);
+        float sn = sin(radians);
+        r.m[0] = c * s.x;
+        r.m[1] = sn * s.x;
+        r.m[2] = -sn * s.y;
+        r.m[3] = c * s.y;
+        r.m[4] = t.x;
+        r.m[5] = t.y;
+        return r;
+    }
+
+    // The xy part of `o`; exact when o.isAffine2D()
+    static constexpr Mat3x2 fromMat4(const Mat4 &o)
+    {
+        Mat3x2 r;
+        r.m[0] = o.m[0];
+        r.m[1] = o.m[1];
+        r.m[2] = o.m[4];
+        r.m[3] = o.m[5];
+        r.m[4] = o.m[12];
+        r.m[5] = o.m[13];
+        return r;
+    }
+
+    // The same transform acting on xy, z left alone
+    constexpr Mat4 toMat4() const
     {
         Mat4 r;
-        for (int row = 0; row < 4; row++)
-            for (int col = 0; col < 4; col++)
-                r.m[col + row * 4] =
-                    m[row * 4 + 0] * o.m[col + 0] +
-                    m[row * 4 + 1] * o.m[col + 4] +
-                    m[row * 4 + 2] * o.m[col + 8] +
-                    m[row * 4 + 3] * o.m[col + 12];
+        r.m[0] = m[0];
+        r.m[1] = m[1];
+        r.m[4] = m[2];
+        r.m[5] = m[3];
+        r.m[12] = m[4];
+        r.m[13] = m[5];
+        return r;
+    }
+
+    // a * b applies b first, as with Mat4
+    constexpr Mat3x2 operator*(const Mat3x2 &o) const
+    {
+        Mat3x2 r;
+        r.m[0] = m[0] * o.m[0] + m[2] * o.m[1];
+        r.m[1] = m[1] * o.m[0] + m[3] * o.m[1];
+        r.m[2] = m[0] * o.m[2] + m[2] * o.m[3];
+        r.m[3] = m[1] * o.m[2] + m[3] * o.m[3];
+        r.m[4] = m[0] * o.m[4] + m[2] * o.m[5] + m[4];
+        r.m[5] = m[1] * o.m[4] + m[3] * o.m[5] + m[5];
         return r;
     }
+
+    constexpr Vector2 transformPoint(const Vector2 &p) const
+    {
+        return Vector2(m[0] * p.x + m[2] * p.y + m[4], m[1] * p.x + m[3] * p.y + m[5]);
+    }
+
+    // Direction only, no translation
+    constexpr Vector2 transformVector(const Vector2 &v) const
+    {
+        return Vector2(m[0] * v.x + m[2] * v.y, m[1] * v.x + m[3] * v.y);
+    }
+
+    constexpr float determinant() const
+    {
+        return m[0] * m[3] - m[2] * m[1];
+    }
+
+    // Sets `out` (may be *this) to the inverse; false (out untouched)
+    // when singular. The inverse of [A | t] is [A^-1 | -A^-1 t], with A^-1 the 2x2 adjugate
+    // over the determinant.
+    constexpr bool inverse(Mat3x2 &out) const
+    {
+        float det = determinant();
+        if (det == 0.0f)
+        {
+            return false;
+        }
+        float inv = 1.0f / det;
+        float a = m[3] * inv;
+        float b = -m[1] * inv;
+        float c = -m[2] * inv;
+        float d = m[0] * inv;
+        float tx = -(a * m[4] + c * m[5]);
+        float ty = -(b * m[4] + d * m[5]);
+        out.m[0] = a;
+        out.m[1] = b;
+        out.m[2] = c;
+        out.m[3] = d;
+        out.m[4] = tx;
+        out.m[5] = ty;
+        return true;
+    }
 };
+
+static_assert(std::is_trivially_copyable<Mat3x2>::value && sizeof(Mat3x2) == 6 * sizeof(float), "Mat3x2 must be 6 packed floats");
 #endif
\ No newline at end of file
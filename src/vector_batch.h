@@ -0,0 +1,607 @@
+#ifndef VECTOR_BATCH_H
+#define VECTOR_BATCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+#include "vector.h"
+#include "bounds.h"
+
+#if defined(MAT4_KERNELS_NEON) && defined(__aarch64__)
+#define VECTOR_BATCH_NEON 1 // needs the AArch64 divide and square root
+#endif
+
+// Bulk kernels behind Vector3Batch, on separate x / y / z float arrays of
+// `n` elements. Like the Mat4 kernels there is a scalar reference and
+// SSE2 / AVX2 / NEON versions picked at runtime; each SIMD version runs
+// full registers and hands the remainder to the scalar one. They do the
+// same operations in the same order, so without FMA contraction every
+// level gives bit-identical results.
+struct Vector3BatchKernels
+{
+    SimdLevel level;
+    void (*scaleAdd)(float *v, size_t n, float s, float t);   // v = v * s + t
+    void (*add)(float *v, const float *o, size_t n);          // v += o
+    void (*transform)(const float *m, float *x, float *y, float *z, size_t n); // points by a Mat4
+    void (*dot)(const float *ax, const float *ay, const float *az,
+                const float *bx, const float *by, const float *bz, float *out, size_t n);
+    void (*length)(const float *x, const float *y, const float *z, float *out, size_t n);
+    void (*normalize)(float *x, float *y, float *z, size_t n); // zero vectors stay zero
+    void (*minMax)(const float *v, size_t n, float &min, float &max); // widens min / max
+};
+
+inline void batchScaleAddScalar(float *v, size_t n, float s, float t)
+{
+    for (size_t i = 0; i < n; i++)
+        v[i] = v[i] * s + t;
+}
+
+inline void batchAddScalar(float *v, const float *o, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        v[i] = v[i] + o[i];
+}
+
+// Same arithmetic as Mat4::transformPoint
+inline void batchTransformScalar(const float *m, float *x, float *y, float *z, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        float px = x[i], py = y[i], pz = z[i];
+        x[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+        y[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+        z[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
+    }
+}
+
+inline void batchDotScalar(const float *ax, const float *ay, const float *az,
+                           const float *bx, const float *by, const float *bz, float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i];
+}
+
+inline void batchLengthScalar(const float *x, const float *y, const float *z, float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+}
+
+inline void batchNormalizeScalar(float *x, float *y, float *z, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        float len = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        if (len > 0)
+        {
+            x[i] = x[i] / len;
+            y[i] = y[i] / len;
+            z[i] = z[i] / len;
+        }
+    }
+}
+
+inline void batchMinMaxScalar(const float *v, size_t n, float &min, float &max)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        min = std::min(min, v[i]);
+        max = std::max(max, v[i]);
+    }
+}
+
+// 4-wide kernels over an ops struct B like the Mat4 ones, plus div,
+// sqrt, min, max, select(mask from positive(len), a, b) and horizontal
+// minimum / maximum
+
+template <typename B>
+inline void batchScaleAddSimd(float *v, size_t n, float s, float t)
+{
+    typename B::V vs = B::splat(s), vt = B::splat(t);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        B::store(v + i, B::add(B::mul(B::load(v + i), vs), vt));
+    batchScaleAddScalar(v + i, n - i, s, t);
+}
+
+template <typename B>
+inline void batchAddSimd(float *v, const float *o, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        B::store(v + i, B::add(B::load(v + i), B::load(o + i)));
+    batchAddScalar(v + i, o + i, n - i);
+}
+
+template <typename B>
+inline void batchTransformSimd(const float *m, float *x, float *y, float *z, size_t n)
+{
+    typedef typename B::V V;
+    V m0 = B::splat(m[0]), m1 = B::splat(m[1]), m2 = B::splat(m[2]);
+    V m4 = B::splat(m[4]), m5 = B::splat(m[5]), m6 = B::splat(m[6]);
+    V m8 = B::splat(m[8]), m9 = B::splat(m[9]), m10 = B::splat(m[10]);
+    V m12 = B::splat(m[12]), m13 = B::splat(m[13]), m14 = B::splat(m[14]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        V px = B::load(x + i), py = B::load(y + i), pz = B::load(z + i);
+        B::store(x + i, B::add(B::add(B::add(B::mul(m0, px), B::mul(m4, py)), B::mul(m8, pz)), m12));
+        B::store(y + i, B::add(B::add(B::add(B::mul(m1, px), B::mul(m5, py)), B::mul(m9, pz)), m13));
+        B::store(z + i, B::add(B::add(B::add(B::mul(m2, px), B::mul(m6, py)), B::mul(m10, pz)), m14));
+    }
+    batchTransformScalar(m, x + i, y + i, z + i, n - i);
+}
+
+template <typename B>
+inline void batchDotSimd(const float *ax, const float *ay, const float *az,
+                         const float *bx, const float *by, const float *bz, float *out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        typename B::V d = B::add(B::mul(B::load(ax + i), B::load(bx + i)), B::mul(B::load(ay + i), B::load(by + i)));
+        B::store(out + i, B::add(d, B::mul(B::load(az + i), B::load(bz + i))));
+    }
+    batchDotScalar(ax + i, ay + i, az + i, bx + i, by + i, bz + i, out + i, n - i);
+}
+
+template <typename B>
+inline typename B::V batchLength4(typename B::V x, typename B::V y, typename B::V z)
+{
+    return B::sqrt(B::add(B::add(B::mul(x, x), B::mul(y, y)), B::mul(z, z)));
+}
+
+template <typename B>
+inline void batchLengthSimd(const float *x, const float *y, const float *z, float *out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        B::store(out + i, batchLength4<B>(B::load(x + i), B::load(y + i), B::load(z + i)));
+    batchLengthScalar(x + i, y + i, z + i, out + i, n - i);
+}
+
+template <typename B>
+inline void batchNormalizeSimd(float *x, float *y, float *z, size_t n)
+{
+    typedef typename B::V V;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        V px = B::load(x + i), py = B::load(y + i), pz = B::load(z + i);
+        V len = batchLength4<B>(px, py, pz);
+        auto keep = B::positive(len);
+        B::store(x + i, B::select(keep, B::div(px, len), px));
+        B::store(y + i, B::select(keep, B::div(py, len), py));
+        B::store(z + i, B::select(keep, B::div(pz, len), pz));
+    }
+    batchNormalizeScalar(x + i, y + i, z + i, n - i);
+}
+
+template <typename B>
+inline void batchMinMaxSimd(const float *v, size_t n, float &min, float &max)
+{
+    if (n < 4)
+    {
+        batchMinMaxScalar(v, n, min, max);
+        return;
+    }
+    typename B::V lo = B::splat(min), hi = B::splat(max);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        typename B::V p = B::load(v + i);
+        lo = B::min(p, lo); // keeps lo on NaN like std::min
+        hi = B::max(p, hi);
+    }
+    min = B::reduceMin(lo);
+    max = B::reduceMax(hi);
+    batchMinMaxScalar(v + i, n - i, min, max);
+}
+
+#ifdef MAT4_KERNELS_SSE2
+struct BatchOpsSSE2 : Mat4OpsSSE2
+{
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V sqrt(V v) { return _mm_sqrt_ps(v); }
+    static V min(V a, V b) { return _mm_min_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V positive(V v) { return _mm_cmpgt_ps(v, _mm_setzero_ps()); }
+    static V select(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    static float reduceMin(V v)
+    {
+        v = _mm_min_ps(v, swapHalves(v));
+        return _mm_cvtss_f32(_mm_min_ss(v, swapPairs(v)));
+    }
+    static float reduceMax(V v)
+    {
+        v = _mm_max_ps(v, swapHalves(v));
+        return _mm_cvtss_f32(_mm_max_ss(v, swapPairs(v)));
+    }
+};
+
+inline void batchScaleAddSSE2(float *v, size_t n, float s, float t) { batchScaleAddSimd<BatchOpsSSE2>(v, n, s, t); }
+inline void batchAddSSE2(float *v, const float *o, size_t n) { batchAddSimd<BatchOpsSSE2>(v, o, n); }
+inline void batchTransformSSE2(const float *m, float *x, float *y, float *z, size_t n) { batchTransformSimd<BatchOpsSSE2>(m, x, y, z, n); }
+inline void batchDotSSE2(const float *ax, const float *ay, const float *az,
+                         const float *bx, const float *by, const float *bz, float *out, size_t n)
+{
+    batchDotSimd<BatchOpsSSE2>(ax, ay, az, bx, by, bz, out, n);
+}
+inline void batchLengthSSE2(const float *x, const float *y, const float *z, float *out, size_t n) { batchLengthSimd<BatchOpsSSE2>(x, y, z, out, n); }
+inline void batchNormalizeSSE2(float *x, float *y, float *z, size_t n) { batchNormalizeSimd<BatchOpsSSE2>(x, y, z, n); }
+inline void batchMinMaxSSE2(const float *v, size_t n, float &min, float &max) { batchMinMaxSimd<BatchOpsSSE2>(v, n, min, max); }
+#endif
+
+#ifdef MAT4_KERNELS_AVX2
+// Written out with intrinsics: a template instantiated outside a
+// target("avx2") function can't inline AVX2 operations
+
+__attribute__((target("avx2"))) inline void batchScaleAddAVX2(float *v, size_t n, float s, float t)
+{
+    __m256 vs = _mm256_set1_ps(s), vt = _mm256_set1_ps(t);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(v + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(v + i), vs), vt));
+    batchScaleAddScalar(v + i, n - i, s, t);
+}
+
+__attribute__((target("avx2"))) inline void batchAddAVX2(float *v, const float *o, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(v + i, _mm256_add_ps(_mm256_loadu_ps(v + i), _mm256_loadu_ps(o + i)));
+    batchAddScalar(v + i, o + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void batchTransformAVX2(const float *m, float *x, float *y, float *z, size_t n)
+{
+    __m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m2 = _mm256_set1_ps(m[2]);
+    __m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]);
+    __m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m10 = _mm256_set1_ps(m[10]);
+    __m256 m12 = _mm256_set1_ps(m[12]), m13 = _mm256_set1_ps(m[13]), m14 = _mm256_set1_ps(m[14]);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, px), _mm256_mul_ps(m4, py)), _mm256_mul_ps(m8, pz)), m12));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, px), _mm256_mul_ps(m5, py)), _mm256_mul_ps(m9, pz)), m13));
+        _mm256_storeu_ps(z + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, px), _mm256_mul_ps(m6, py)), _mm256_mul_ps(m10, pz)), m14));
+    }
+    batchTransformScalar(m, x + i, y + i, z + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void batchDotAVX2(const float *ax, const float *ay, const float *az,
+                                                         const float *bx, const float *by, const float *bz, float *out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 d = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(ax + i), _mm256_loadu_ps(bx + i)),
+                                 _mm256_mul_ps(_mm256_loadu_ps(ay + i), _mm256_loadu_ps(by + i)));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(az + i), _mm256_loadu_ps(bz + i))));
+    }
+    batchDotScalar(ax + i, ay + i, az + i, bx + i, by + i, bz + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline __m256 batchLength8(__m256 x, __m256 y, __m256 z)
+{
+    return _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+}
+
+__attribute__((target("avx2"))) inline void batchLengthAVX2(const float *x, const float *y, const float *z, float *out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, batchLength8(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i)));
+    batchLengthScalar(x + i, y + i, z + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void batchNormalizeAVX2(float *x, float *y, float *z, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        __m256 len = batchLength8(px, py, pz);
+        __m256 keep = _mm256_cmp_ps(len, _mm256_setzero_ps(), _CMP_GT_OQ);
+        _mm256_storeu_ps(x + i, _mm256_blendv_ps(px, _mm256_div_ps(px, len), keep));
+        _mm256_storeu_ps(y + i, _mm256_blendv_ps(py, _mm256_div_ps(py, len), keep));
+        _mm256_storeu_ps(z + i, _mm256_blendv_ps(pz, _mm256_div_ps(pz, len), keep));
+    }
+    batchNormalizeScalar(x + i, y + i, z + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void batchMinMaxAVX2(const float *v, size_t n, float &min, float &max)
+{
+    if (n < 8)
+    {
+        batchMinMaxScalar(v, n, min, max);
+        return;
+    }
+    __m256 lo = _mm256_set1_ps(min), hi = _mm256_set1_ps(max);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 p = _mm256_loadu_ps(v + i);
+        lo = _mm256_min_ps(p, lo);
+        hi = _mm256_max_ps(p, hi);
+    }
+    min = BatchOpsSSE2::reduceMin(_mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1)));
+    max = BatchOpsSSE2::reduceMax(_mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1)));
+    batchMinMaxScalar(v + i, n - i, min, max);
+}
+#endif
+
+#ifdef VECTOR_BATCH_NEON
+struct BatchOpsNEON : Mat4OpsNEON
+{
+    static V div(V a, V b) { return vdivq_f32(a, b); }
+    static V sqrt(V v) { return vsqrtq_f32(v); }
+    static V min(V a, V b) { return vminq_f32(a, b); }
+    static V max(V a, V b) { return vmaxq_f32(a, b); }
+    static uint32x4_t positive(V v) { return vcgtq_f32(v, vdupq_n_f32(0.0f)); }
+    static V select(uint32x4_t mask, V a, V b) { return vbslq_f32(mask, a, b); }
+    static float reduceMin(V v) { return vminvq_f32(v); }
+    static float reduceMax(V v) { return vmaxvq_f32(v); }
+};
+
+inline void batchScaleAddNEON(float *v, size_t n, float s, float t) { batchScaleAddSimd<BatchOpsNEON>(v, n, s, t); }
+inline void batchAddNEON(float *v, const float *o, size_t n) { batchAddSimd<BatchOpsNEON>(v, o, n); }
+inline void batchTransformNEON(const float *m, float *x, float *y, float *z, size_t n) { batchTransformSimd<BatchOpsNEON>(m, x, y, z, n); }
+inline void batchDotNEON(const float *ax, const float *ay, const float *az,
+                         const float *bx, const float *by, const float *bz, float *out, size_t n)
+{
+    batchDotSimd<BatchOpsNEON>(ax, ay, az, bx, by, bz, out, n);
+}
+inline void batchLengthNEON(const float *x, const float *y, const float *z, float *out, size_t n) { batchLengthSimd<BatchOpsNEON>(x, y, z, out, n); }
+inline void batchNormalizeNEON(float *x, float *y, float *z, size_t n) { batchNormalizeSimd<BatchOpsNEON>(x, y, z, n); }
+inline void batchMinMaxNEON(const float *v, size_t n, float &min, float &max) { batchMinMaxSimd<BatchOpsNEON>(v, n, min, max); }
+#endif
+
+// Kernels for `level`, or nullptr when this build or CPU can't run them
+inline const Vector3BatchKernels *vector3BatchKernelsFor(SimdLevel level)
+{
+    static const Vector3BatchKernels scalar = {SimdLevel::Scalar, batchScaleAddScalar, batchAddScalar, batchTransformScalar,
+                                               batchDotScalar, batchLengthScalar, batchNormalizeScalar, batchMinMaxScalar};
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return &scalar;
+#ifdef MAT4_KERNELS_SSE2
+    case SimdLevel::SSE2:
+    {
+        static const Vector3BatchKernels sse2 = {SimdLevel::SSE2, batchScaleAddSSE2, batchAddSSE2, batchTransformSSE2,
+                                                 batchDotSSE2, batchLengthSSE2, batchNormalizeSSE2, batchMinMaxSSE2};
+        return &sse2;
+    }
+#endif
+#ifdef MAT4_KERNELS_AVX2
+    case SimdLevel::AVX2:
+    {
+        static const Vector3BatchKernels avx2 = {SimdLevel::AVX2, batchScaleAddAVX2, batchAddAVX2, batchTransformAVX2,
+                                                 batchDotAVX2, batchLengthAVX2, batchNormalizeAVX2, batchMinMaxAVX2};
+        return cpuHasAVX2() ? &avx2 : nullptr;
+    }
+#endif
+#ifdef VECTOR_BATCH_NEON
+    case SimdLevel::NEON:
+    {
+        static const Vector3BatchKernels neon = {SimdLevel::NEON, batchScaleAddNEON, batchAddNEON, batchTransformNEON,
+                                                 batchDotNEON, batchLengthNEON, batchNormalizeNEON, batchMinMaxNEON};
+        return &neon;
+    }
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+// Fastest batch kernels for this build and CPU. The batch levels don't
+// follow the Mat4 ones exactly (32-bit ARM has NEON Mat4 kernels but no
+// NEON batch kernels), so fall back level by level down to scalar.
+inline const Vector3BatchKernels *bestVector3BatchKernels()
+{
+    for (SimdLevel level : {bestSimdLevel(), SimdLevel::SSE2, SimdLevel::Scalar})
+    {
+        const Vector3BatchKernels *kernels = vector3BatchKernelsFor(level);
+        if (kernels != nullptr)
+        {
+            return kernels;
+        }
+    }
+    return nullptr; // unreachable, there is always a scalar version
+}
+
+inline const Vector3BatchKernels *&activeVector3BatchKernels()
+{
+    static const Vector3BatchKernels *kernels = bestVector3BatchKernels();
+    return kernels;
+}
+
+inline const Vector3BatchKernels &vector3BatchKernels()
+{
+    return *activeVector3BatchKernels();
+}
+
+// Same as setMat4Kernels() for the batch kernels
+inline bool setVector3BatchKernels(SimdLevel level)
+{
+    const Vector3BatchKernels *kernels = vector3BatchKernelsFor(level);
+    if (kernels == nullptr)
+    {
+        return false;
+    }
+    activeVector3BatchKernels() = kernels;
+    return true;
+}
+
+// Structure-of-arrays list of Vector3: all the x, then all the y, then
+// all the z, so bulk operations run a full SIMD register of vectors per
+// instruction. Convert from / to std::vector<Vector3> at the edges (GL
+// uploads and Shape keep interleaved vertices).
+class Vector3Batch
+{
+public:
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    Vector3Batch() {}
+
+    explicit Vector3Batch(const std::vector<Vector3> &v)
+    {
+        assign(v.data(), v.size());
+    }
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    void resize(size_t n)
+    {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+    }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+
+    void reserve(size_t n)
+    {
+        x.reserve(n);
+        y.reserve(n);
+        z.reserve(n);
+    }
+
+    void push_back(const Vector3 &v)
+    {
+        x.push_back(v.x);
+        y.push_back(v.y);
+        z.push_back(v.z);
+    }
+
+    Vector3 get(size_t i) const
+    {
+        return Vector3(x[i], y[i], z[i]);
+    }
+
+    void set(size_t i, const Vector3 &v)
+    {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
+
+    void assign(const Vector3 *v, size_t n)
+    {
+        resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            x[i] = v[i].x;
+            y[i] = v[i].y;
+            z[i] = v[i].z;
+        }
+    }
+
+    void assign(const std::vector<Vector3> &v)
+    {
+        assign(v.data(), v.size());
+    }
+
+    // Writes size() vectors to `out`
+    void copyTo(Vector3 *out) const
+    {
+        for (size_t i = 0; i < size(); i++)
+        {
+            out[i] = Vector3(x[i], y[i], z[i]);
+        }
+    }
+
+    std::vector<Vector3> toVector() const
+    {
+        std::vector<Vector3> v(size());
+        copyTo(v.data());
+        return v;
+    }
+
+    // Translates every vector by `t`
+    void add(const Vector3 &t)
+    {
+        const Vector3BatchKernels &k = vector3BatchKernels();
+        k.scaleAdd(x.data(), size(), 1.0f, t.x);
+        k.scaleAdd(y.data(), size(), 1.0f, t.y);
+        k.scaleAdd(z.data(), size(), 1.0f, t.z);
+    }
+
+    // Element-wise sum with a batch of the same size
+    void add(const Vector3Batch &o)
+    {
+        const Vector3BatchKernels &k = vector3BatchKernels();
+        k.add(x.data(), o.x.data(), size());
+        k.add(y.data(), o.y.data(), size());
+        k.add(z.data(), o.z.data(), size());
+    }
+
+    // Scales each component by the matching one of `s`
+    void scale(const Vector3 &s)
+    {
+        const Vector3BatchKernels &k = vector3BatchKernels();
+        k.scaleAdd(x.data(), size(), s.x, 0.0f);
+        k.scaleAdd(y.data(), size(), s.y, 0.0f);
+        k.scaleAdd(z.data(), size(), s.z, 0.0f);
+    }
+
+    void scale(float s)
+    {
+        scale(Vector3(s, s, s));
+    }
+
+    // Transforms every vector as a point, like Mat4::transformPoint
+    void transform(const Mat4 &m)
+    {
+        vector3BatchKernels().transform(m.m, x.data(), y.data(), z.data(), size());
+    }
+
+    // out[i] = get(i).dot(o.get(i)); `o` must be the same size
+    void dot(const Vector3Batch &o, std::vector<float> &out) const
+    {
+        out.resize(size());
+        vector3BatchKernels().dot(x.data(), y.data(), z.data(), o.x.data(), o.y.data(), o.z.data(), out.data(), size());
+    }
+
+    void length(std::vector<float> &out) const
+    {
+        out.resize(size());
+        vector3BatchKernels().length(x.data(), y.data(), z.data(), out.data(), size());
+    }
+
+    // Like Vector3::normalize() on each vector
+    void normalize()
+    {
+        vector3BatchKernels().normalize(x.data(), y.data(), z.data(), size());
+    }
+
+    // Smallest box around every vector (an empty box for an empty batch)
+    AABB bounds() const
+    {
+        AABB box;
+        if (empty())
+        {
+            return box;
+        }
+        const Vector3BatchKernels &k = vector3BatchKernels();
+        box.min = box.max = get(0);
+        k.minMax(x.data(), size(), box.min.x, box.max.x);
+        k.minMax(y.data(), size(), box.min.y, box.max.y);
+        k.minMax(z.data(), size(), box.min.z, box.max.z);
+        return box;
+    }
+};
+
+#endif